@@ -4,6 +4,8 @@
 #include <stdio.h>
 #include <string.h>
 #include <array>
+#define SHLAG_UTF8_IMPL
+#include "shlag_utf8.h" // from shlag/, so build it with something like: c++ -O2 -I../shlag trie.cpp
 
 // Simple universal (utf-8) trie implementation I written for early pass at 1st sem course "fundamentals of programming"
 // I tested it on SJP wordlist: https://sjp.pl/sl/growy/sjp-20230402.zip (42MB, 3.2 milion polish words)
@@ -20,10 +22,25 @@
 //
 // After all, trie (at least that simple) seems to be only worth to give a fuck if you 
 // need prefix search (or maybe when you have a lot of similar queries or a lot of mismatches)
+//
+// There is also alternative engine with bitmap-indexed nodes (build with -DTRIE_BITMAP, see
+// BitmapTrie). On generated polish-like list (2.1M words, `scripts/pgo` generator) its peak
+// RSS is 147MB instead of 165MB. That includes whole dict (22MB), which it keeps in memory
+// during load, as it is read twice. Load takes 0.6s instead of 0.7s, and shuffled query 1.8s
+// instead of 1.9s. Lookup itself is way cheaper, but random query time is dominated by
+// cache misses anyway, so it's not a big win there. It can't load dicts with more than 62
+// distinct bytes (e.g. mixed case ascii with digits and punctuation)
 
 #define MAXLINE 256
 // Max size of "word" buffer you can save in tree.
 
+// Set operations between two trees (words printed by printSetOp)
+enum SetOp {
+    SET_DIFF, // in first tree, but not in second
+    SET_INTERSECT, // in both
+    SET_UNION, // in any
+};
+
 struct LetterTree {
     LetterTree* childs;
     uint8_t childCount;
@@ -59,6 +76,13 @@ struct LetterTree {
     // Free tree's memory recursivly.
     void recursiveFree();
 
+    // Sort childs by letter recursivly, so words are visited in sorted (strcmp) order
+    void sortChilds();
+
+    // Print result of set operation between this and @other tree in sorted order. Both trees
+    // are walked together once, so it is linear in their size (plus sorting childs)
+    void printSetOp(LetterTree& other, SetOp op);
+
 #if defined(__GNUC__) && (defined(__i386__) || defined(__amd64__))
 }__attribute__((packed));
 // Removing struct padding saves us a lot of memory.
@@ -161,6 +185,229 @@ int LetterTree::printWords2(int limit, char path[MAXLINE], int pathLen)
     return limit;
 }
 
+// Alternative engine, enabled with -DTRIE_BITMAP. Bytes that occur in dict are remapped to
+// dense alphabet of symbols (0 is end of word, then letters in byte order, 63 is reserved for
+// bytes never seen in dict), so each node can hold 64-bit presence bitmap of its childs instead
+// of letters. Childs are stored in symbol order, so child of symbol s sits at index
+// popcount(bitmap & bits below s) - lookup is O(1) and branch-free, instead of linear scan.
+// End of word is just bit 0, so it doesn't take whole node like '\0' in LetterTree.
+// Nodes are 16 bytes (LetterTree ones are 10), but there are a lot less of them, and they
+// are never scanned. Words are also printed in sorted order, as side effect.
+// Bitmap has room for 62 letters, so dicts with more distinct bytes are rejected (it's
+// enough for polish or other alphabet of single case, but not for arbitrary text).
+// Build it with -mpopcnt (or -march=native), otherwise popcount is libgcc call
+#define BITMAP_SYMBOLS 64
+#define BITMAP_UNKNOWN (BITMAP_SYMBOLS - 1) // symbol of bytes not in alphabet, never present
+
+#if defined(__GNUC__)
+ #define popcount64(x) __builtin_popcountll(x)
+ #define ctz64(x) __builtin_ctzll(x)
+#else
+static int popcount64(uint64_t x)
+{
+    x = x - ((x >> 1) & 0x5555555555555555ULL);
+    x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+    x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    return (x * 0x0101010101010101ULL) >> 56;
+}
+static int ctz64(uint64_t x) { return popcount64((x & -x) - 1); }
+#endif
+
+struct BitmapNode {
+    uint64_t bitmap; // bit n set means there is child with symbol n (bit 0 - word ends here)
+    BitmapNode* childs; // one per set bit except bit 0, in symbol order
+
+    // index of child with symbol @s (s > 0), whether it exists or not
+    int childIndex(int s) { return popcount64(bitmap & ((1ULL << s) - 2)); }
+};
+
+struct BitmapTrie {
+    BitmapNode root;
+    uint8_t symbol[256]; // byte -> symbol
+    char letter[BITMAP_SYMBOLS]; // symbol -> byte
+
+    // Build alphabet from bytes present in dict. Has to be called before first insert
+    void initAlphabet(const char* dict, size_t len);
+
+    // Same API as LetterTree
+    void insertString(const char* str);
+    bool findString(const char* str);
+    void printPrefixed(const char* prefix, int n);
+    // Return -1 if too much words, @limit if no words, and (@limit - word_count) otherwise
+    int printWords(BitmapNode* node, int limit, char path[MAXLINE], int pathLen);
+    // Childs are always sorted, so it's just merge. Alphabets of trees may differ, but symbol
+    // order is byte order in both, so they are merged by bytes
+    void printSetOp(BitmapTrie& other, SetOp op);
+    void printMerged(BitmapNode* a, BitmapTrie& other, BitmapNode* b, SetOp op, char path[MAXLINE], int pathLen);
+};
+
+void BitmapTrie::initAlphabet(const char* dict, size_t len)
+{
+    bool used[256] = {false};
+    for(size_t i = 0; i < len; ++i) used[(uint8_t)dict[i]] = true;
+    used['\0'] = used['\n'] = used['\r'] = false; // never part of word
+    int count = 1;
+    memset(symbol, BITMAP_UNKNOWN, sizeof(symbol));
+    memset(letter, 0, sizeof(letter));
+    symbol[0] = 0;
+    for(int c = 1; c < 256; ++c) {
+        if(!used[c]) continue;
+        if(count == BITMAP_UNKNOWN) {
+            fprintf(stderr, "dict error: more than %d distinct bytes, too much for bitmap nodes\n", BITMAP_UNKNOWN - 1);
+            exit(1);
+        }
+        letter[count] = c;
+        symbol[c] = count++;
+    }
+}
+
+void BitmapTrie::insertString(const char* str)
+{
+    BitmapNode* node = &root;
+    for(;; ++str) {
+        const int s = symbol[(uint8_t)*str];
+        const uint64_t bit = 1ULL << s;
+        if(s != 0 && !(node->bitmap & bit)) {
+            // same realloc + 1 as in LetterTree, but new child goes in the middle
+            const int count = popcount64(node->bitmap & ~1ULL);
+            const int idx = node->childIndex(s);
+            node->childs = (BitmapNode*)realloc(node->childs, sizeof(BitmapNode) * (count+1));
+            if(node->childs == NULL) { perror("dict error"); exit(1); }
+            memmove(&node->childs[idx+1], &node->childs[idx], sizeof(BitmapNode) * (count-idx));
+            node->childs[idx].bitmap = 0;
+            node->childs[idx].childs = NULL;
+        }
+        node->bitmap |= bit;
+        if(s == 0) return;
+        node = &node->childs[node->childIndex(s)];
+    }
+}
+
+bool BitmapTrie::findString(const char* str)
+{
+    BitmapNode* node = &root;
+    for(;; ++str) {
+        const int s = symbol[(uint8_t)*str];
+        if(!(node->bitmap & (1ULL << s))) return false;
+        if(s == 0) return true;
+        node = &node->childs[node->childIndex(s)];
+    }
+}
+
+void BitmapTrie::printPrefixed(const char* prefix, int limit)
+{
+    char buf[MAXLINE] = {0};
+    BitmapNode* node = &root;
+    for(int i = 0; prefix[i] != '\0'; ++i) {
+        const int s = symbol[(uint8_t)prefix[i]];
+        if(!(node->bitmap & (1ULL << s))) return; // there is no word starting with suplied prefix
+        node = &node->childs[node->childIndex(s)];
+        buf[i] = prefix[i];
+    }
+    if(printWords(node, limit, buf, strlen(buf)) == limit) { puts("No words found"); }
+}
+
+int BitmapTrie::printWords(BitmapNode* node, int limit, char path[MAXLINE], int pathLen)
+{
+    assert(pathLen+1 < MAXLINE);
+    if(node->bitmap & 1) {
+        if(limit == 0) { puts("..."); return TOO_MUCH_CHILDS; }
+        path[pathLen] = '\0';
+        puts(path);
+        --limit;
+    }
+    int idx = 0;
+    for(uint64_t rest = node->bitmap & ~1ULL; rest && limit != TOO_MUCH_CHILDS; rest &= rest - 1) {
+        if(limit == 0) { puts("..."); return TOO_MUCH_CHILDS; }
+        path[pathLen] = letter[ctz64(rest)];
+        limit = printWords(&node->childs[idx++], limit, path, pathLen + 1);
+    }
+    path[pathLen] = '\0';
+    return limit;
+}
+
+void BitmapTrie::printSetOp(BitmapTrie& other, SetOp op)
+{
+    char path[MAXLINE] = {0};
+    printMerged(&root, other, &other.root, op, path, 0);
+}
+
+// same as printMerged() of LetterTree, @a is from this tree, @b from @other
+void BitmapTrie::printMerged(BitmapNode* a, BitmapTrie& other, BitmapNode* b, SetOp op, char path[MAXLINE], int pathLen)
+{
+    assert(pathLen+1 < MAXLINE);
+    const bool endA = a && (a->bitmap & 1), endB = b && (b->bitmap & 1);
+    if((endA && endB && op != SET_DIFF) || (endA && !endB && op != SET_INTERSECT) || (endB && !endA && op == SET_UNION)) {
+        path[pathLen] = '\0';
+        puts(path);
+    }
+    uint64_t restA = a ? a->bitmap & ~1ULL : 0, restB = b ? b->bitmap & ~1ULL : 0;
+    int i = 0, j = 0;
+    while(restA || restB) {
+        const int letterA = restA ? (uint8_t)letter[ctz64(restA)] : 256;
+        const int letterB = restB ? (uint8_t)other.letter[ctz64(restB)] : 256;
+        BitmapNode* childA = NULL;
+        BitmapNode* childB = NULL;
+        if(letterA <= letterB) { childA = &a->childs[i++]; restA &= restA - 1; }
+        if(letterB <= letterA) { childB = &b->childs[j++]; restB &= restB - 1; }
+        if(!childB && op == SET_INTERSECT) continue;
+        if(!childA && op != SET_UNION) continue;
+        path[pathLen] = letterA < letterB ? letterA : letterB;
+        printMerged(childA, other, childB, op, path, pathLen + 1);
+    }
+    path[pathLen] = '\0';
+}
+
+#ifdef TRIE_BITMAP
+typedef BitmapTrie Trie;
+#else
+typedef LetterTree Trie;
+#endif
+
+static int compareLetters(const void* a, const void* b)
+{
+    return (uint8_t)((const LetterTree*)a)->letter - (uint8_t)((const LetterTree*)b)->letter;
+}
+
+void LetterTree::sortChilds()
+{
+    if(childCount == 0) return; // childs is NULL then
+    qsort(childs, childCount, sizeof(LetterTree), compareLetters);
+    for(uint8_t i = 0; i<childCount; ++i) {
+        childs[i].sortChilds();
+    }
+}
+
+// Walk sorted subtrees @a and @b (NULL if path exists only in other one) like merge of
+// two sorted lists, and print words that @op selects
+static void printMerged(LetterTree* a, LetterTree* b, SetOp op, char path[MAXLINE], int pathLen)
+{
+    assert(pathLen+1 < MAXLINE);
+    const int countA = a ? a->childCount : 0, countB = b ? b->childCount : 0;
+    int i = 0, j = 0;
+    while(i < countA || j < countB) {
+        const int letterA = i < countA ? (uint8_t)a->childs[i].letter : 256;
+        const int letterB = j < countB ? (uint8_t)b->childs[j].letter : 256;
+        LetterTree* childA = letterA <= letterB ? &a->childs[i++] : NULL;
+        LetterTree* childB = letterB <= letterA ? &b->childs[j++] : NULL;
+        if(!childB && op == SET_INTERSECT) continue; // only in a
+        if(!childA && op != SET_UNION) continue; // only in b
+        if(childA && childB && op == SET_DIFF && letterA == '\0') continue; // word in both
+        path[pathLen] = letterA < letterB ? letterA : letterB;
+        if(path[pathLen] == '\0') puts(path);
+        else printMerged(childA, childB, op, path, pathLen + 1);
+    }
+    path[pathLen] = '\0';
+}
+
+void LetterTree::printSetOp(LetterTree& other, SetOp op)
+{
+    char path[MAXLINE] = {0};
+    sortChilds();
+    other.sortChilds();
+    printMerged(this, &other, op, path, 0);
+}
+
 char* readword(FILE* file, char buf[MAXLINE])
 {
     char* ptr = fgets(buf, MAXLINE, file);
@@ -172,19 +419,62 @@ char* readword(FILE* file, char buf[MAXLINE])
     return ptr;
 }
 
-LetterTree readWordlist(const char* filename)
+#ifdef TRIE_BITMAP
+// Read whole @file into malloc'ed buffer
+char* slurp(FILE* file, size_t* len)
+{
+    size_t cap = 1 << 16;
+    char* data = (char*)malloc(cap);
+    *len = 0;
+    for(;;) {
+        if(data == NULL) { perror("dict error"); exit(1); }
+        *len += fread(data + *len, 1, cap - *len, file);
+        if(*len < cap) break;
+        cap *= 2;
+        data = (char*)realloc(data, cap);
+    }
+    if(ferror(file)) { perror("dict error"); exit(1); }
+    return data;
+}
+#endif
+
+Trie readWordlist(const char* filename)
 {
-    LetterTree tree = {NULL, 0, '\0'};
+    Trie tree = {};
     FILE* file = fopen(filename, "r");
     if(file == NULL) { perror("dict error"); exit(1); }
+#ifdef TRIE_BITMAP
+    // alphabet has to be known before first insert, so dict is read twice. It can be pipe
+    // (e.g. <(unzip -p sjp.zip)), so it's kept in memory and words are read from there
+    size_t len;
+    char* data = slurp(file, &len);
+    fclose(file);
+    tree.initAlphabet(data, len);
+    if(len == 0) { free(data); return tree; } // fmemopen() may refuse empty buffer
+    file = fmemopen(data, len, "r");
+    if(file == NULL) { perror("dict error"); exit(1); }
+#endif
     char buf[MAXLINE];
     while(readword(file, buf)) {
+        // line is already in cache, so checking it here is almost free comparing to separate pass.
+        // Malformed words would be otherwise silently stored, and never matched by valid queries.
+        // Queries aren't checked: malformed ones can't be in tree, so they just mismatch
+        const int64_t len = strlen(buf);
+        const int64_t valid = shlag_utf8_validate(buf, len);
+        if(valid != len) {
+            fprintf(stderr, "dict error: invalid utf-8 at byte %d of line \"%.*s...\"\n", (int)valid, (int)valid, buf);
+            exit(1);
+        }
         tree.insertString(buf);
     }
     fclose(file);
+#ifdef TRIE_BITMAP
+    free(data);
+#endif
     return tree;
 }
 
+#ifndef TRIE_NO_MAIN // defined by trieperf.cpp, which includes this file for engines only
 void help(char* progname)
 {
     fprintf(stderr, 
@@ -193,19 +483,33 @@ void help(char* progname)
     " Print each mismatched line: %s wordlist.txt --invert\n"
     " Print 1 on match and 0 on mismatch: %s wordlist.txt --bool\n"
     " Print list of 'prefix matches': %s wordlist.txt --prefix\n"
-    , progname, progname, progname, progname);
+    " Print sorted words from first list, that are not in second: %s wordlist.txt --diff wordlist2.txt\n"
+    " Print sorted words that are in both lists: %s wordlist.txt --intersect wordlist2.txt\n"
+    " Print sorted words that are in any list: %s wordlist.txt --union wordlist2.txt\n"
+    , progname, progname, progname, progname, progname, progname, progname);
     exit(1);
 }
 
 int main(int argc, char** argv)
 {
     bool invert = 0, boolmode = 0, prefixmode = 0;
+    if(argc == 4) {
+        SetOp op;
+        if(!strcmp(argv[2], "--diff")) op = SET_DIFF;
+        else if(!strcmp(argv[2], "--intersect")) op = SET_INTERSECT;
+        else if(!strcmp(argv[2], "--union")) op = SET_UNION;
+        else help(argv[0]);
+        Trie tree = readWordlist(argv[1]);
+        Trie other = readWordlist(argv[3]);
+        tree.printSetOp(other, op);
+        return 0;
+    }
     if(argc == 3 && !strcmp(argv[2], "--invert")) invert=true;
     else if(argc == 3 && !strcmp(argv[2], "--bool")) boolmode=true;
     else if(argc == 3 && !strcmp(argv[2], "--prefix")) prefixmode=true;
     else if(argc != 2 || !strcmp(argv[1], "-h")) help(argv[0]);
 
-    LetterTree tree = readWordlist(argv[1]);
+    Trie tree = readWordlist(argv[1]);
     if(invert + boolmode + prefixmode > 1) { 
         fprintf(stderr, "dict error: Options can't be combined\n");
         exit(1);
@@ -228,6 +532,7 @@ int main(int argc, char** argv)
     // tree.recursiveFree(); 
     // Tree lives through whole program, and freeing it is slow, so we leave it up to OS
 }
+#endif
 
 // Optimization ideas (listed mostly out of academic curiosity)
 // I don't know whether I will implement them, as:
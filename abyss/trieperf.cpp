@@ -0,0 +1,120 @@
+// Performance regression gate for trie lookup, same idea as shlag/tests/b64perf.c. First run
+// records baseline, later ones fail if lookup got slower than it (by more than tolerance):
+// ./trieperf perf.baseline         # on old commit, records
+// ./trieperf perf.baseline         # on new commit, compares
+// SHITEST_BASELINE_UPDATE=1 ./trieperf perf.baseline # accept new numbers
+// Dictionary is generated polish-like wordlist (like in scripts/pgo), so nothing has to be
+// downloaded. Build it with -DTRIE_BITMAP (and -mpopcnt) to gate bitmap engine instead
+//
+// To build it without buildsystem, run something like:
+// c++ -O2 -I../shlag trieperf.cpp -o trieperf
+#define TRIE_NO_MAIN
+#include "trie.cpp"
+#define SHLAG_PCG_IMPL
+#include "shlag_pcg.h"
+#define SHITEST_IMPL
+#include "shitest.h"
+
+#define TOLERANCE 0.25 // timings on shared machines are noisy, so it isn't tight
+#define WORDS 20000 // tree fits in cache, otherwise dram latency makes it too noisy to gate
+#define MAXWORD 32 // bytes, with newline
+#define QUERIES 4096 // per benchmark call, ~10% of them are misses
+
+#ifdef TRIE_BITMAP
+ #define ENGINE "trie_bitmap"
+#else
+ #define ENGINE "trie"
+#endif
+
+typedef struct Ctx {
+    Trie* tree;
+    char* queries[QUERIES];
+} Ctx;
+
+static void find(void* ctx)
+{
+    Ctx* c = (Ctx*)ctx;
+    int found = 0;
+    for(int i = 0; i < QUERIES; ++i) found += c->tree->findString(c->queries[i]);
+    shi_do_not_optimize(found);
+}
+
+// random stems with common endings, so tree has both shared prefixes and branching near
+// leafs. Words are written to @dict one per line (like dict file), return its length
+static size_t gen_words(char* dict, char* words[WORDS], shlag_pcg32* rng)
+{
+    static const char* letters[] = {
+        "a", "b", "c", "d", "e", "f", "g", "h", "i", "j", "k", "l", "m", "n", "o", "p",
+        "r", "s", "t", "u", "w", "y", "z", "ą", "ć", "ę", "ł", "ń", "ó", "ś", "ź", "ż",
+    };
+    static const char* endings[] = {
+        "a", "y", "i", "e", "ę", "ą", "o", "u", "em", "ami", "ach", "om", "owi", "ów", "ość",
+    };
+    const uint32_t nletters = sizeof(letters)/sizeof(letters[0]);
+    const uint32_t nendings = sizeof(endings)/sizeof(endings[0]);
+    size_t len = 0;
+    for(int w = 0; w < WORDS; ++w) {
+        words[w] = dict + len;
+        const uint32_t stemLen = shlag_pcg32_randrange(rng, 2, 9);
+        for(uint32_t i = 0; i < stemLen; ++i) {
+            const char* l = letters[shlag_pcg32_randrange0(rng, nletters)];
+            memcpy(dict + len, l, strlen(l));
+            len += strlen(l);
+        }
+        const char* e = endings[shlag_pcg32_randrange0(rng, nendings)];
+        memcpy(dict + len, e, strlen(e));
+        len += strlen(e);
+        dict[len++] = '\n';
+    }
+    return len;
+}
+
+int main(int argc, char** argv)
+{
+    if(argc != 2) {
+        fprintf(stderr, "Usage: %s baseline_file\n", argv[0]);
+        return 1;
+    }
+    char* dict = (char*)malloc((size_t)WORDS * MAXWORD);
+    char** words = (char**)malloc(WORDS * sizeof(char*));
+    char* misses = (char*)malloc(QUERIES * MAXWORD);
+    if(!dict || !words || !misses) {
+        fprintf(stderr, "not enough memory\n");
+        return 1;
+    }
+    shlag_pcg32 rng;
+    shlag_pcg32_srand(&rng, 2137, 42);
+    const size_t len = gen_words(dict, words, &rng);
+
+    Trie tree = {};
+#ifdef TRIE_BITMAP
+    tree.initAlphabet(dict, len);
+#endif
+    for(size_t i = 0; i < len; ++i) if(dict[i] == '\n') dict[i] = '\0';
+    for(int w = 0; w < WORDS; ++w) tree.insertString(words[w]);
+
+    // random order, like shuffled query in trie.cpp notes
+    Ctx c;
+    c.tree = &tree;
+    for(int i = 0; i < QUERIES; ++i) {
+        char* word = words[shlag_pcg32_randrange0(&rng, WORDS)];
+        if(shlag_pcg32_randrange0(&rng, 10) != 0) { c.queries[i] = word; continue; }
+        c.queries[i] = misses + i * MAXWORD;
+        snprintf(c.queries[i], MAXWORD, "%sx", word);
+    }
+
+    shi_baseline_load(argv[1]);
+    char name[64];
+    snprintf(name, sizeof(name), ENGINE "_find/%d", QUERIES);
+    shi_bench_check(name, find, &c, TOLERANCE);
+    if(!shi_baseline_save(argv[1])) {
+        fprintf(stderr, "can't write %s\n", argv[1]);
+        return 1;
+    }
+    // tree is left to OS, like in trie.cpp
+    free(dict);
+    free(words);
+    free(misses);
+    fputs(SHI_SEP, stderr);
+    return (shi_test_summary() > 0);
+}
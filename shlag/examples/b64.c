@@ -0,0 +1,417 @@
+// Streaming base64 encoder/decoder built on shlag_b64. Drop-in replacement for
+// coreutils `base64` (output is byte-identical), but way faster on big inputs.
+// Regular files (also when redirected to stdin) are mmaped, pipes are read and written
+// by two helper threads with double buffering, so IO overlaps with encoding.
+// Usage is same as coreutils (-d, -i, -w COLS). Build with -march=native (or at least
+// -mssse3) to get SIMD kernels. To build it without buildsystem, run something like:
+// cc -O2 -march=native -I. examples/b64.c -o bin/b64 -lpthread
+#define _GNU_SOURCE
+#define SHLAG_B64_IMPL
+#include "shlag_b64.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define CHUNK (3 << 18) // 768KiB of input per step. Multiple of 3, so only last one has leftover
+#define ALIGN 4096
+
+static const char* progname = "b64";
+
+static void die(const char* msg)
+{
+    fprintf(stderr, "%s: %s\n", progname, msg);
+    exit(1);
+}
+static void die_errno(const char* what)
+{
+    fprintf(stderr, "%s: %s: %s\n", progname, what, strerror(errno));
+    exit(1);
+}
+static void* xalloc(size_t n)
+{
+    void* p = aligned_alloc(ALIGN, (n + ALIGN - 1) / ALIGN * ALIGN);
+    if(!p) die_errno("alloc");
+    return p;
+}
+
+// -- double buffering --
+// Single producer, single consumer channel with two buffers. Producer fills one while
+// consumer drains the other. Publishing buffer of length 0 means EOF
+typedef struct Chan {
+    pthread_mutex_t mu;
+    pthread_cond_t cv;
+    char* buf[2];
+    size_t len[2];
+    bool full[2];
+    int prod, cons; // slot that producer/consumer use next
+} Chan;
+
+static void chan_init(Chan* c, size_t cap)
+{
+    pthread_mutex_init(&c->mu, NULL);
+    pthread_cond_init(&c->cv, NULL);
+    for(int i = 0; i < 2; ++i) {
+        c->buf[i] = xalloc(cap);
+        c->len[i] = 0; c->full[i] = false;
+    }
+    c->prod = c->cons = 0;
+}
+// wait for empty buffer and return it
+static char* chan_acquire_empty(Chan* c)
+{
+    pthread_mutex_lock(&c->mu);
+    while(c->full[c->prod]) pthread_cond_wait(&c->cv, &c->mu);
+    pthread_mutex_unlock(&c->mu);
+    return c->buf[c->prod];
+}
+static void chan_publish(Chan* c, size_t len)
+{
+    pthread_mutex_lock(&c->mu);
+    c->len[c->prod] = len;
+    c->full[c->prod] = true;
+    c->prod ^= 1;
+    pthread_cond_signal(&c->cv);
+    pthread_mutex_unlock(&c->mu);
+}
+// wait for filled buffer and return it. Returns NULL on EOF
+static char* chan_acquire_full(Chan* c, size_t* len)
+{
+    pthread_mutex_lock(&c->mu);
+    while(!c->full[c->cons]) pthread_cond_wait(&c->cv, &c->mu);
+    *len = c->len[c->cons];
+    pthread_mutex_unlock(&c->mu);
+    return *len ? c->buf[c->cons] : NULL;
+}
+static void chan_release(Chan* c)
+{
+    pthread_mutex_lock(&c->mu);
+    c->full[c->cons] = false;
+    c->cons ^= 1;
+    pthread_cond_signal(&c->cv);
+    pthread_mutex_unlock(&c->mu);
+}
+
+typedef struct Pipe {
+    Chan chan;
+    int fd;
+    size_t chunk; // reader fills buffers up to that size
+    pthread_t thread;
+} Pipe;
+
+static void* reader_thread(void* arg)
+{
+    Pipe* p = arg;
+    size_t len;
+    do { // last buffer is usually partial, but we keep going until we publish empty one (EOF)
+        char* buf = chan_acquire_empty(&p->chan);
+        ssize_t n = 1;
+        len = 0;
+        // fill whole buffer, so chunks stay multiple of 3 (pipes return partial reads)
+        while(len < p->chunk && (n = read(p->fd, buf + len, p->chunk - len)) != 0) {
+            if(n < 0 && errno == EINTR) continue;
+            if(n < 0) die_errno("read error");
+            len += n;
+        }
+        chan_publish(&p->chan, len);
+    } while(len != 0);
+    return NULL;
+}
+static void* writer_thread(void* arg)
+{
+    Pipe* p = arg;
+    const char* buf;
+    size_t len;
+    while((buf = chan_acquire_full(&p->chan, &len))) {
+        while(len > 0) {
+            ssize_t n = write(p->fd, buf, len);
+            if(n < 0 && errno == EINTR) continue;
+            if(n < 0) die_errno("write error");
+            buf += n; len -= n;
+        }
+        chan_release(&p->chan);
+    }
+    return NULL;
+}
+
+// -- input: mmap or reader thread --
+typedef struct Input {
+    const char* map; // NULL if we use reader thread
+    size_t mapSize, mapPos;
+    Pipe pipe;
+} Input;
+
+static void input_open(Input* in, int fd, size_t bufcap)
+{
+    struct stat st;
+    if(fstat(fd, &st) < 0) die_errno("stat");
+    in->map = NULL;
+    if(S_ISREG(st.st_mode) && st.st_size > 0) {
+        void* map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(map != MAP_FAILED) {
+            madvise(map, st.st_size, MADV_SEQUENTIAL);
+            in->map = map; in->mapSize = st.st_size; in->mapPos = 0;
+            return;
+        }
+    } // if mmap isn't possible, just read it
+    in->pipe.fd = fd;
+    in->pipe.chunk = CHUNK;
+    chan_init(&in->pipe.chan, bufcap);
+    if(pthread_create(&in->pipe.thread, NULL, reader_thread, &in->pipe)) die("can't create thread");
+}
+// Get next chunk (at most CHUNK bytes). Returns NULL on EOF. @writable tells whether chunk
+// lives in our own buffer (of bufcap size), that can be reused for output
+static char* input_next(Input* in, size_t* len, bool* writable)
+{
+    if(in->map) {
+        *writable = false;
+        if(in->mapPos == in->mapSize) return NULL;
+        *len = in->mapSize - in->mapPos < CHUNK ? in->mapSize - in->mapPos : CHUNK;
+        in->mapPos += *len;
+        return (char*)in->map + in->mapPos - *len;
+    }
+    *writable = true;
+    return chan_acquire_full(&in->pipe.chan, len);
+}
+static void input_release(Input* in)
+{
+    if(!in->map) chan_release(&in->pipe.chan);
+}
+
+// -- output: writer thread --
+typedef struct Output {
+    Pipe pipe;
+    char* buf; // buffer currently being filled
+    size_t len, cap;
+} Output;
+
+static void output_open(Output* out, int fd, size_t cap)
+{
+    out->pipe.fd = fd;
+    chan_init(&out->pipe.chan, cap);
+    out->cap = cap;
+    out->len = 0;
+    out->buf = chan_acquire_empty(&out->pipe.chan);
+    if(pthread_create(&out->pipe.thread, NULL, writer_thread, &out->pipe)) die("can't create thread");
+}
+static void output_flush(Output* out)
+{
+    if(out->len == 0) return;
+    chan_publish(&out->pipe.chan, out->len);
+    out->buf = chan_acquire_empty(&out->pipe.chan);
+    out->len = 0;
+}
+// return space for at least @n bytes (n <= cap)
+static char* output_reserve(Output* out, size_t n)
+{
+    if(out->cap - out->len < n) output_flush(out);
+    return out->buf + out->len;
+}
+static void output_close(Output* out)
+{
+    output_flush(out);
+    chan_publish(&out->pipe.chan, 0);
+    pthread_join(out->pipe.thread, NULL);
+}
+
+// -- encoding --
+
+// copy @n chars into @out, inserting newline after every @wrap chars. @col is current column
+static size_t wrap_copy(const char* in, size_t n, char* out, size_t wrap, size_t* col)
+{
+    char* start = out;
+    while(n > 0) {
+        size_t k = wrap - *col < n ? wrap - *col : n;
+        memcpy(out, in, k);
+        out += k; in += k; n -= k;
+        *col += k;
+        if(*col == wrap) { *out++ = '\n'; *col = 0; }
+    }
+    return out - start;
+}
+
+static void encode(Input* in, Output* out, size_t wrap, char* scratch)
+{
+    char* chunk;
+    size_t len, col = 0;
+    bool writable, any = false;
+    while((chunk = input_next(in, &len, &writable))) {
+        const size_t encLen = SHLAG_B64_ENCSIZE(len) - 1;
+        if(wrap == 0) {
+            shlag_b64enc((uint8_t*)chunk, len, output_reserve(out, encLen + 1));
+            out->len += encLen;
+        } else {
+            // read buffers are big enough for inplace encoding, mmaped input isn't writable
+            char* enc = writable ? chunk : scratch;
+            shlag_b64enc((uint8_t*)chunk, len, enc);
+            out->len += wrap_copy(enc, encLen, output_reserve(out, encLen + encLen / wrap + 1), wrap, &col);
+        }
+        any = true;
+        input_release(in);
+    }
+    if(wrap && any && col) {
+        *output_reserve(out, 1) = '\n';
+        out->len++;
+    }
+}
+
+// -- decoding --
+
+typedef struct Decoder {
+    char* buf; // input with newlines (or garbage) removed, waiting for complete groups
+    size_t len;
+    bool ignoreGarbage;
+    bool garbage[256]; // chars to drop with --ignore-garbage
+} Decoder;
+
+// append @in to decoder buffer, dropping newlines (or all non-alphabet chars)
+static void strip_append(Decoder* d, const char* in, size_t n)
+{
+    char* out = d->buf + d->len;
+    if(d->ignoreGarbage) {
+        for(size_t i = 0; i < n; ++i) {
+            *out = in[i];
+            out += !d->garbage[(uint8_t)in[i]];
+        }
+    } else {
+        const char* end = in + n;
+        while(in < end) {
+            const char* nl = memchr(in, '\n', end - in);
+            size_t k = (nl ? nl : end) - in;
+            memmove(out, in, k);
+            out += k;
+            in += k + (nl != NULL);
+        }
+    }
+    d->len = out - d->buf;
+}
+
+// Decode part of stream that failed to decode as a whole. It outputs as much as coreutils
+// would (complete groups, then longest decodable prefix of the bad one) and dies
+static void decode_invalid(const char* in, size_t n, Output* out)
+{
+    uint8_t* o = (uint8_t*)output_reserve(out, n);
+    size_t i = 0;
+    int64_t k;
+    for(; i + 4 <= n && (k = shlag_b64dec(in + i, 4, o)) >= 0; i += 4) {
+        o += k; out->len += k;
+    }
+    for(size_t prefix = (n - i < 3 ? n - i : 3); prefix >= 2; --prefix) {
+        if((k = shlag_b64dec(in + i, prefix, o)) >= 0) { out->len += k; break; }
+    }
+    output_close(out);
+    die("invalid input");
+}
+
+// decode all complete groups in decoder buffer. Padding may end the stream and start
+// another one (e.g. concatenated outputs), so we cut buffer into segments ending on padded group
+static void decode_flush(Decoder* d, Output* out, bool eof)
+{
+    size_t pos = 0;
+    while(pos < d->len) {
+        const size_t avail = d->len - pos;
+        const char* pad = memchr(d->buf + pos, '=', avail);
+        size_t n = pad ? (size_t)(pad - (d->buf + pos)) / 4 * 4 + 4 : avail / 4 * 4;
+        if(n == 0 || n > avail) { // incomplete group
+            if(!eof) break;
+            n = avail;
+        }
+        int64_t k = n % 4 ? -1 : shlag_b64dec(d->buf + pos, n, (uint8_t*)output_reserve(out, n));
+        if(k < 0) decode_invalid(d->buf + pos, n, out);
+        out->len += k;
+        pos += n;
+    }
+    memmove(d->buf, d->buf + pos, d->len - pos);
+    d->len -= pos;
+}
+
+static void decode(Input* in, Output* out, bool ignoreGarbage)
+{
+    Decoder d;
+    d.buf = xalloc(CHUNK + 4);
+    d.len = 0;
+    d.ignoreGarbage = ignoreGarbage;
+    const char* alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/=";
+    for(int c = 0; c < 256; ++c) d.garbage[c] = (c == 0 || !strchr(alphabet, c));
+
+    char* chunk;
+    size_t len;
+    bool writable;
+    while((chunk = input_next(in, &len, &writable))) {
+        while(len > 0) { // decoder buffer may hold leftover from previous chunk
+            size_t n = CHUNK + 4 - d.len < len ? CHUNK + 4 - d.len : len;
+            strip_append(&d, chunk, n);
+            decode_flush(&d, out, false);
+            chunk += n; len -= n;
+        }
+        input_release(in);
+    }
+    decode_flush(&d, out, true);
+}
+
+static void usage(void)
+{
+    fprintf(stderr,
+    "Usage: %s [-d] [-i] [-w COLS] [FILE]\n"
+    "Base64 encode or decode FILE, or stdin if FILE is missing or '-'\n"
+    " -d, --decode          decode data\n"
+    " -i, --ignore-garbage  when decoding, ignore non-alphabet characters\n"
+    " -w, --wrap=COLS       wrap encoded lines after COLS characters (default 76), 0 disables\n"
+    , progname);
+    exit(1);
+}
+
+int main(int argc, char** argv)
+{
+    bool decodeMode = false, ignoreGarbage = false;
+    size_t wrap = 76;
+    static const struct option longopts[] = {
+        {"decode", no_argument, NULL, 'd'},
+        {"ignore-garbage", no_argument, NULL, 'i'},
+        {"wrap", required_argument, NULL, 'w'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0}
+    };
+    int opt;
+    while((opt = getopt_long(argc, argv, "diw:h", longopts, NULL)) != -1) {
+        char* end;
+        switch(opt) {
+        case 'd': decodeMode = true; break;
+        case 'i': ignoreGarbage = true; break;
+        case 'w':
+            errno = 0;
+            wrap = strtoul(optarg, &end, 10);
+            if(errno || *end || *optarg == '-') die("invalid wrap size");
+            break;
+        default: usage();
+        }
+    }
+    if(argc - optind > 1) usage();
+
+    int fd = STDIN_FILENO;
+    if(optind < argc && strcmp(argv[optind], "-") != 0) {
+        fd = open(argv[optind], O_RDONLY);
+        if(fd < 0) die_errno(argv[optind]);
+    }
+    // encoding may be done inplace in read buffers, and wrapping at most doubles output
+    const size_t encCap = SHLAG_B64_ENCSIZE(CHUNK);
+    Input in;
+    input_open(&in, fd, encCap);
+    Output out;
+    output_open(&out, STDOUT_FILENO, 2 * encCap);
+
+    if(decodeMode) {
+        decode(&in, &out, ignoreGarbage);
+    } else {
+        encode(&in, &out, wrap, in.map && wrap ? xalloc(encCap) : NULL);
+    }
+    output_close(&out);
+    return 0;
+}
@@ -0,0 +1,113 @@
+// Print utf8 text as newline-separated list of codepoints. Native replacement for
+// `scripts/codepoint` (output is byte-identical, e.g U+0105), but validates input with
+// shlag_utf8 at GB/s instead of going through iconv | xxd | awk.
+// Usage: codepoint [-c] [file...]
+// Without files (or with "-") it reads stdin. With -c it only validates, without printing
+// anything. On invalid input it prints codepoints of valid prefix, then offset of first
+// bad byte, and exits with 1, so it can be used for checking dictionaries before loading.
+// Build with -march=native (or at least -mssse3) to get SIMD validation (meson builds
+// codepoint_simd like that). To build it without buildsystem, run something like:
+// cc -O2 -march=native -I. examples/codepoint.c -o bin/codepoint
+#define SHLAG_UTF8_IMPL
+#include "shlag_utf8.h"
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CHUNK (1 << 20) // bytes of input per step
+#define BATCH 4096 // codepoints formatted per fwrite()
+#define MAXSEQ 4 // longest utf8 sequence
+
+static const char* progname = "codepoint";
+
+static void die_errno(const char* what)
+{
+    fprintf(stderr, "%s: %s: %s\n", progname, what, strerror(errno));
+    exit(1);
+}
+
+// write "U+XXXX\n" lines, hex is lowercase and zero-padded to 4 digits (like in script)
+static void print_codepoints(const uint32_t* cps, int64_t n)
+{
+    static const char hex[] = "0123456789abcdef";
+    char out[BATCH * sizeof("U+10ffff\n")];
+    for(int64_t i = 0; i < n; i += BATCH) {
+        const int64_t end = i + BATCH < n ? i + BATCH : n;
+        char* o = out;
+        for(int64_t k = i; k < end; ++k) {
+            uint32_t cp = cps[k];
+            const int digits = cp > 0xFFFFF ? 6 : cp > 0xFFFF ? 5 : 4;
+            *o++ = 'U'; *o++ = '+';
+            for(int d = digits - 1; d >= 0; --d, cp >>= 4) o[d] = hex[cp & 0xF];
+            o += digits;
+            *o++ = '\n';
+        }
+        if(fwrite(out, 1, o - out, stdout) != (size_t)(o - out)) die_errno("write error");
+    }
+}
+
+// decode (and print unless @check) whole stream. Returns false on invalid utf8
+static bool process(FILE* file, const char* name, bool check, char* buf, uint32_t* cps)
+{
+    int64_t carry = 0; // bytes of incomplete sequence moved from end of previous chunk
+    int64_t offset = 0; // offset of buf[0] in stream
+    for(;;) {
+        const int64_t got = fread(buf + carry, 1, CHUNK, file);
+        if(got < CHUNK && ferror(file)) die_errno(name);
+        const bool eof = got < CHUNK;
+        const int64_t n = carry + got;
+        // don't cut sequence in half: leave last one for next chunk if it might be incomplete
+        int64_t cut = n;
+        if(!eof) {
+            int64_t p = n - 1;
+            while(p > 0 && p > n - MAXSEQ && ((uint8_t)buf[p] & 0xC0) == 0x80) --p;
+            if((uint8_t)buf[p] >= 0xC0) cut = p;
+        }
+        // validation is inside decode, so on happy path input is read once
+        int64_t count = check ? (shlag_utf8_validate(buf, cut) == cut ? 0 : -1)
+                              : shlag_utf8_decode(buf, cut, cps);
+        if(count < 0) {
+            const int64_t valid = shlag_utf8_validate(buf, cut);
+            if(!check) print_codepoints(cps, shlag_utf8_decode(buf, valid, cps));
+            fflush(stdout);
+            fprintf(stderr, "%s: %s: invalid utf-8 at byte %lld\n", progname, name,
+                    (long long)(offset + valid));
+            return false;
+        }
+        print_codepoints(cps, count);
+        if(eof) return true;
+        carry = n - cut;
+        memmove(buf, buf + cut, carry);
+        offset += cut;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    bool check = false;
+    int first = 1;
+    if(argc > 1 && !strcmp(argv[1], "-c")) { check = true; ++first; }
+    else if(argc > 1 && argv[1][0] == '-' && argv[1][1] != '\0') {
+        fprintf(stderr, "Usage: %s [-c] [file...]\n", progname);
+        return 1;
+    }
+    char* buf = (char*)malloc(CHUNK + MAXSEQ);
+    uint32_t* cps = (uint32_t*)malloc((CHUNK + MAXSEQ) * sizeof(uint32_t));
+    if(!buf || !cps) { fprintf(stderr, "%s: not enough memory\n", progname); return 1; }
+
+    bool ok = true;
+    if(first == argc) ok = process(stdin, "-", check, buf, cps);
+    for(int i = first; i < argc && ok; ++i) {
+        if(!strcmp(argv[i], "-")) { ok = process(stdin, "-", check, buf, cps); continue; }
+        FILE* file = fopen(argv[i], "rb");
+        if(!file) die_errno(argv[i]);
+        ok = process(file, argv[i], check, buf, cps);
+        fclose(file);
+    }
+    if(fflush(stdout) != 0) die_errno("write error");
+    free(buf);
+    free(cps);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,266 @@
+// Write raw output of shlag_pcg generators to stdout, in big blocks, so it can be piped
+// into statistical test batteries, e.g:
+// ./pcg_stream | RNG_test stdin32 (PractRand)
+// ./pcg_stream -g pcg64 | RNG_test stdin64
+// ./pcg_stream | dieharder -a -g 200
+// Numbers are written in native byte order. Generators:
+// - pcg32: shlag_pcg32_rand() (stream is same as pcg32-demo from pcg-c, for same seed)
+// - pcg32x8: shlag_pcg32x8_rand(), lanes are consecutive split() substreams. Output is
+//   interleaved: lane0 lane1 ... lane7 lane0 ...
+// - pcg64: shlag_pcg64_rand()
+//
+// With -b it instead benchmarks generators and prints ns/number, in google benchmark
+// like format (pipe it into `scripts/gmintbl`)
+//
+// To build it without buildsystem, run something like:
+// cc -O2 -march=native -I. examples/pcg_stream.c -o bin/pcg_stream
+#define SHLAG_PCG_IMPL
+#include "shlag_pcg.h"
+#include <errno.h>
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BLOCK (1 << 20) // bytes per write(), multiple of 32 (size of one pcg32x8 step)
+#define MIN_TIME 0.2 // seconds spent in each benchmark (more or less)
+
+static const char* progname = "pcg_stream";
+
+static void die(const char* msg)
+{
+    fprintf(stderr, "%s: %s\n", progname, msg);
+    exit(1);
+}
+
+typedef struct Gen {
+    shlag_pcg32 pcg32;
+    shlag_pcg32x8 pcg32x8;
+    shlag_pcg64 pcg64;
+} Gen;
+
+static void gen_seed(Gen* g, uint64_t initstate, uint64_t initseq)
+{
+    shlag_pcg32_srand(&g->pcg32, initstate, initseq);
+    shlag_pcg32 lanes[8];
+    shlag_pcg32_split(&g->pcg32, lanes, 0, 8);
+    shlag_pcg32x8_pack(&g->pcg32x8, lanes);
+    shlag_pcg64_srand(&g->pcg64, initstate, initseq);
+}
+
+// Block producers. @n is number of bytes, it is multiple of 32
+static void block_pcg32(Gen* g, void* buf, size_t n)
+{
+    shlag_pcg32_fill(&g->pcg32, (uint32_t*)buf, n / sizeof(uint32_t));
+}
+
+static void block_pcg32x8(Gen* g, void* buf, size_t n)
+{
+    uint32_t* out = (uint32_t*)buf;
+    for(size_t i = 0; i < n / sizeof(uint32_t); i += 8) shlag_pcg32x8_rand(&g->pcg32x8, out + i);
+}
+
+static void block_pcg64(Gen* g, void* buf, size_t n)
+{
+    uint64_t* out = (uint64_t*)buf;
+    for(size_t i = 0; i < n / sizeof(uint64_t); ++i) out[i] = shlag_pcg64_rand(&g->pcg64);
+}
+
+static const struct {
+    const char* name;
+    void (*block)(Gen*, void*, size_t);
+} generators[] = {
+    {"pcg32", block_pcg32},
+    {"pcg32x8", block_pcg32x8},
+    {"pcg64", block_pcg64},
+};
+
+static void write_all(const char* buf, size_t n)
+{
+    while(n > 0) {
+        ssize_t written = write(STDOUT_FILENO, buf, n);
+        if(written < 0 && errno == EINTR) continue;
+        if(written < 0) exit(errno == EPIPE ? 0 : 1); // reader is done, that's normal
+        buf += written;
+        n -= written;
+    }
+}
+
+// write @limit bytes (UINT64_MAX is practically forever)
+static void stream(Gen* g, void (*block)(Gen*, void*, size_t), uint64_t limit)
+{
+    uint64_t* buf = malloc(BLOCK); // uint64_t, so it is aligned for all generators
+    if(!buf) die("out of memory");
+    for(uint64_t done = 0; done < limit; done += BLOCK) {
+        block(g, buf, BLOCK);
+        write_all((const char*)buf, limit - done < BLOCK ? limit - done : BLOCK);
+    }
+    free(buf);
+}
+
+// Benchmarks of per number APIs. Each one generates n numbers
+static volatile uint64_t sink; // keeps results from being optimized away
+
+static void bench_rand(Gen* g, size_t n)
+{
+    uint32_t acc = 0;
+    for(size_t i = 0; i < n; ++i) acc += shlag_pcg32_rand(&g->pcg32);
+    sink = acc;
+}
+
+static void bench_randrange0_small(Gen* g, size_t n)
+{
+    uint32_t acc = 0;
+    for(size_t i = 0; i < n; ++i) acc += shlag_pcg32_randrange0(&g->pcg32, 6);
+    sink = acc;
+}
+
+// worst case for Lemire's method, almost half of numbers gets rejected
+static void bench_randrange0_large(Gen* g, size_t n)
+{
+    uint32_t acc = 0;
+    for(size_t i = 0; i < n; ++i) acc += shlag_pcg32_randrange0(&g->pcg32, 0x80000001);
+    sink = acc;
+}
+
+static void bench_bounded_large(Gen* g, size_t n)
+{
+    const shlag_pcg32_bounded bounded = shlag_pcg32_bounded_init(0, 0x80000001);
+    uint32_t acc = 0;
+    for(size_t i = 0; i < n; ++i) acc += shlag_pcg32_bounded_rand(&g->pcg32, &bounded);
+    sink = acc;
+}
+
+static void bench_pcg64_rand(Gen* g, size_t n)
+{
+    uint64_t acc = 0;
+    for(size_t i = 0; i < n; ++i) acc += shlag_pcg64_rand(&g->pcg64);
+    sink = acc;
+}
+
+static void bench_pcg64_randrange0_large(Gen* g, size_t n)
+{
+    uint64_t acc = 0;
+    for(size_t i = 0; i < n; ++i) acc += shlag_pcg64_randrange0(&g->pcg64, 0x8000000000000001);
+    sink = acc;
+}
+
+static double now(clockid_t clk)
+{
+    struct timespec t;
+    clock_gettime(clk, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+// Generate blocks (from @block or @numbers) until MIN_TIME passes, and print ns/number
+static void bench(Gen* g, const char* name, void (*block)(Gen*, void*, size_t),
+        void (*numbers)(Gen*, size_t), size_t numberSize, void* buf)
+{
+    const size_t perBlock = BLOCK / numberSize;
+    int64_t iters = 0;
+    double cpu = now(CLOCK_PROCESS_CPUTIME_ID), t = now(CLOCK_MONOTONIC), elapsed;
+    do {
+        if(block) block(g, buf, BLOCK);
+        else numbers(g, perBlock);
+        sink += ((uint8_t*)buf)[0];
+        ++iters;
+    } while((elapsed = now(CLOCK_MONOTONIC) - t) < MIN_TIME);
+    cpu = now(CLOCK_PROCESS_CPUTIME_ID) - cpu;
+    const double count = (double)iters * perBlock;
+    printf("%-40s %10.3f ns %10.3f ns %10lld\n", name, elapsed / count * 1e9, cpu / count * 1e9,
+            (long long)(iters * perBlock));
+    fflush(stdout);
+}
+
+static void benchmark(Gen* g)
+{
+    void* buf = malloc(BLOCK);
+    if(!buf) die("out of memory");
+    memset(buf, 0, BLOCK);
+    // google benchmark prints context to stderr and table to stdout, so gmintbl skips 3 lines
+    fprintf(stderr, "%s: time per number\n", progname);
+    const char* sep = "----------------------------------------------------------------------------\n";
+    printf("%s%-40s %13s %13s %10s\n%s", sep, "Benchmark", "Time", "CPU", "Iterations", sep);
+    for(unsigned i = 0; i < sizeof(generators)/sizeof(generators[0]); ++i) {
+        char name[64];
+        snprintf(name, sizeof(name), "stream_%s", generators[i].name);
+        bench(g, name, generators[i].block, NULL, strcmp(generators[i].name, "pcg64") ? 4 : 8, buf);
+    }
+    bench(g, "pcg32_rand", NULL, bench_rand, 4, buf);
+    bench(g, "pcg32_randrange0_small", NULL, bench_randrange0_small, 4, buf);
+    bench(g, "pcg32_randrange0_large", NULL, bench_randrange0_large, 4, buf);
+    bench(g, "pcg32_bounded_large", NULL, bench_bounded_large, 4, buf);
+    bench(g, "pcg64_rand", NULL, bench_pcg64_rand, 8, buf);
+    bench(g, "pcg64_randrange0_large", NULL, bench_pcg64_randrange0_large, 8, buf);
+    free(buf);
+}
+
+static void usage(void)
+{
+    fprintf(stderr,
+    "Usage: %s [-g GEN] [-n BYTES] [-s INITSTATE INITSEQ]\n"
+    "       %s -b\n"
+    "Write raw random numbers to stdout (forever, unless -n is given)\n"
+    " -g, --generator=GEN   pcg32 (default), pcg32x8 or pcg64\n"
+    " -n, --bytes=BYTES     stop after BYTES bytes\n"
+    " -s, --seed            seed with INITSTATE and INITSEQ (default: 42 54)\n"
+    " -b, --bench           print ns/number for each generator and API instead\n"
+    , progname, progname);
+    exit(1);
+}
+
+static uint64_t parse_u64(const char* str, const char* what)
+{
+    char* end;
+    errno = 0;
+    unsigned long long v = strtoull(str, &end, 10);
+    if(errno || *end || !*str || *str == '-') die(what);
+    return v;
+}
+
+int main(int argc, char** argv)
+{
+    bool benchMode = false, seeded = false;
+    unsigned genIdx = 0;
+    uint64_t limit = UINT64_MAX, initstate = 42, initseq = 54;
+    static const struct option longopts[] = {
+        {"generator", required_argument, NULL, 'g'},
+        {"bytes", required_argument, NULL, 'n'},
+        {"seed", no_argument, NULL, 's'},
+        {"bench", no_argument, NULL, 'b'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0}
+    };
+    int opt;
+    while((opt = getopt_long(argc, argv, "g:n:sbh", longopts, NULL)) != -1) {
+        switch(opt) {
+        case 'g':
+            for(genIdx = 0; genIdx < sizeof(generators)/sizeof(generators[0]); ++genIdx) {
+                if(!strcmp(optarg, generators[genIdx].name)) break;
+            }
+            if(genIdx == sizeof(generators)/sizeof(generators[0])) die("unknown generator");
+            break;
+        case 'n': limit = parse_u64(optarg, "invalid byte count"); break;
+        case 's': seeded = true; break;
+        case 'b': benchMode = true; break;
+        default: usage();
+        }
+    }
+    if(seeded) {
+        if(argc - optind != 2) usage();
+        initstate = parse_u64(argv[optind], "invalid initstate");
+        initseq = parse_u64(argv[optind + 1], "invalid initseq");
+    } else if(optind != argc) {
+        usage();
+    }
+
+    Gen g;
+    gen_seed(&g, initstate, initseq);
+    if(benchMode) benchmark(&g);
+    else if(limit != UINT64_MAX || !isatty(STDOUT_FILENO)) stream(&g, generators[genIdx].block, limit);
+    else die("refusing to write endless binary garbage to terminal, pipe it somewhere");
+    return 0;
+}
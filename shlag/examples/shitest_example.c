@@ -23,6 +23,19 @@ unsigned char* my_memdupa(unsigned char* mem, int size)
 
 void binary_memory_advanced_test();
 
+void bench_square(void* ctx)
+{
+    int x = 42;
+    shi_do_not_optimize(x); // otherwise compiler could precompute it
+    x = square(x);
+    shi_do_not_optimize(x); // otherwise compiler could skip computing it at all
+}
+void bench_memset(void* ctx)
+{
+    memset(ctx, 0xaa, 4096);
+    shi_do_not_optimize(ctx);
+}
+
 int main()
 {
     // simple passing test
@@ -76,6 +89,12 @@ int main()
     shi_assert(square(2) == 4);
     shi_test_end();
 
+    // benchmarks. Function is called with supplied ctx (repeatedly, count is chosen
+    // automatically), and median/min time per call gets printed
+    shi_bench("square", bench_square, NULL);
+    char buf[4096];
+    shi_bench("memset_4k", bench_memset, buf);
+
     fputs(SHI_SEP, stderr);
 
     return (shi_test_summary() > 0);
@@ -0,0 +1,74 @@
+// Example for fork-per-test runner. Some tests intentionally fail, crash or hang.
+// To build it without buildsystem, run something like:
+// cc -I. examples/shitest_fork_example.c -o bin/shitest_fork_example
+#define _POSIX_C_SOURCE 200809L // runner needs posix stuff, even with -std=c99
+#define SHITEST_IMPL
+#define SHITEST_FORK
+#define SHITEST_TIMEOUT 1 // seconds, default is 60
+#include "shitest.h"
+#include <stdlib.h>
+
+// sum of 1..n. Intentionally broken for big n
+static long sum_to(long n)
+{
+    return n < 1000 ? n * (n + 1) / 2 : 0;
+}
+
+static void sum_small_test(void* ctx)
+{
+    shi_assert_eq(55, sum_to(10), "%ld", long);
+}
+
+// ctx can be used for passing parameters
+static void sum_test(void* ctx)
+{
+    long n = *(long*)ctx;
+    shi_assert_eq(n * (n + 1) / 2, sum_to(n), "%ld", long);
+}
+
+static void crashing_test(void* ctx)
+{
+    volatile int* ptr = NULL;
+    *ptr = 42;
+}
+
+static void hanging_test(void* ctx)
+{
+    for(;;) {}
+}
+
+static void exiting_test(void* ctx)
+{
+    exit(3);
+}
+
+// with NULL name, function does shi_test() calls by itself, so it can contain whole group
+static void group_of_tests(void* ctx)
+{
+    for(long n = 1; n < 5000; n *= 4) {
+        shi_test("sum_to(%ld)", n);
+        shi_assert_eq(n * (n + 1) / 2, sum_to(n), "%ld", long);
+        shi_test_end();
+    }
+}
+
+int main()
+{
+    // inline tests still work, also mixed with registered ones
+    shi_test("inline_test");
+    shi_assert_eq(0, sum_to(0), "%ld", long);
+    shi_test_end();
+
+    long ns[] = {100, 999, 1000};
+    shi_register("sum_small_test", sum_small_test, NULL);
+    for(int i = 0; i < 3; ++i) shi_register("sum_test", sum_test, &ns[i]);
+    shi_register("crashing_test", crashing_test, NULL);
+    shi_register("hanging_test", hanging_test, NULL);
+    shi_register("exiting_test", exiting_test, NULL);
+    shi_register(NULL, group_of_tests, NULL);
+    // 0 jobs means number of cores. Output is printed in registration order anyway
+    shi_run_registered(0);
+
+    fputs(SHI_SEP, stderr);
+    return (shi_test_summary() > 0);
+}
@@ -0,0 +1,93 @@
+// Example for asserting from multiple threads. Some tests intentionally fail.
+// To build it without buildsystem, run something like:
+// cc -I. examples/shitest_thread_example.c -o bin/shitest_thread_example -pthread
+#define SHITEST_IMPL
+#include "shitest.h"
+#include <pthread.h>
+
+#define THREADS 8
+#define ITERS 1000000
+
+// tiny "data structure" under test: counter that is broken for one of threads
+typedef struct Counter {
+    pthread_mutex_t lock;
+    long value;
+} Counter;
+
+// add one and return new value
+static long counter_add(Counter* c, int thread)
+{
+    pthread_mutex_lock(&c->lock);
+    long value = c->value += thread == 5 ? 2 : 1; // intentionally broken
+    pthread_mutex_unlock(&c->lock);
+    return value;
+}
+
+typedef struct Worker {
+    pthread_t thread;
+    Counter* counter;
+    int id;
+} Worker;
+
+// adds to counter and asserts in tight loop. Passing asserts are cheap, so it's fine
+static void* worker(void* arg)
+{
+    Worker* w = (Worker*)arg;
+    shi_thread_begin(); // needed before first assert in thread
+    long prev = 0;
+    for(long i = 0; i < ITERS; ++i) {
+        long value = counter_add(w->counter, w->id);
+        // counter only grows. We stop at first failure, to avoid million of msgs
+        shi_assert_f(value > prev, "thread %d: counter didn't grow", w->id);
+        if(value <= prev) break;
+        prev = value;
+    }
+    // msgs of thread are printed together
+    shi_assert_f(w->id != 5, "thread %d: some msg", w->id);
+    shi_assert_f(w->id != 5, "thread %d: another msg", w->id);
+    shi_thread_end(); // prints buffered msgs, and marks running test as failed
+    return NULL;
+}
+
+static void counter_test(int threads)
+{
+    shi_test("counter_test(%d threads)", threads);
+    Counter counter = {PTHREAD_MUTEX_INITIALIZER, 0};
+    Worker workers[THREADS];
+    for(int i = 0; i < threads; ++i) {
+        workers[i].counter = &counter;
+        workers[i].id = i;
+        pthread_create(&workers[i].thread, NULL, worker, &workers[i]);
+    }
+    for(int i = 0; i < threads; ++i) pthread_join(workers[i].thread, NULL);
+    // main thread can assert too
+    shi_assert_eq((long)threads * ITERS, counter.value, "%ld", long);
+    shi_test_end(); // OK only if all threads passed
+}
+
+// thread without shi_thread_begin() still fails running test, but its msgs aren't grouped
+static void* unregistered_worker(void* arg)
+{
+    shi_assert_f(*(int*)arg == 0, "unregistered thread: some msg");
+    return NULL;
+}
+
+static void unregistered_thread_test()
+{
+    shi_test("unregistered_thread_test");
+    pthread_t thread;
+    int value = 1;
+    pthread_create(&thread, NULL, unregistered_worker, &value);
+    pthread_join(thread, NULL);
+    shi_test_end(); // fails
+}
+
+int main()
+{
+    counter_test(4); // passes, thread 5 isn't there
+    counter_test(THREADS); // fails
+    unregistered_thread_test();
+
+    fputs(SHI_SEP, stderr);
+    return (shi_test_summary() > 0);
+}
@@ -2,19 +2,21 @@
 // frameworks, such as gtest, which add a lot of unnecessary abstraction that just
 // goes in your way (for instance - you can't just run tests in loop, good boys
 // use "parametrized test" magic). Shitest is just bunch of assert routines, wrappers
-// around printf, and short summary. Of course, it lacks some fancier, yet
-// sometimes useful features like timing, test order randomization or forking each
-// test into separate process (so other tests won't be affected by crash or
-// something). Too bad!
+// around printf, short summary, and simple benchmark routine. Of course, it lacks some
+// fancier, yet sometimes useful features like test order randomization. Too bad!
+// There is opt-in (posix only) runner that forks each test into separate process
+// and runs them in parallel (so other tests won't be affected by crash or something),
+// see SHITEST_FORK below
 //
 // Used namespaces: SHITEST_, SHI_, shi_
 // In *one* of C or C++ file, you have to define SHITEST_IMPL before including
 // shitest. For examples see `shlag/examples/shitest_example.c` and `shlag/tests/`
 // directory
 //
+// Counters are atomic and test status is thread-local, so you can assert from multiple
+// threads (with gcc, clang or msvc). See shi_thread_begin() for details
+//
 // KNOWN BUGS:
-// - Probably not thread safe. To be honest I haven't use threads yet, but I
-// hope that this is trivially mitigable
 // - If you print some debug info during test case, sometimes output may
 // look kinda strange (it still should be readable tho). I don't have any simple 
 // mitigation idea
@@ -24,6 +26,7 @@
 #include <stdio.h>
 #include <stdbool.h>
 #include <stdarg.h>
+#include <stdint.h>
 #include <string.h>
 
 // Prepend public function definitions with whatever you want. You can use it
@@ -74,6 +77,50 @@ SHITEST_DEF void shi_assert_memeq_f(const void *expected, const void *actual, si
 // summarize tests. Returns count of failed tests
 SHITEST_DEF unsigned shi_test_summary();
 
+// Benchmark @fn (called with @ctx) and print result. Iteration count is calibrated so
+// single repetition takes ~SHITEST_BENCH_TIME seconds, then it does SHITEST_BENCH_REPS
+// repetitions and reports median and min time per call. Output mimics google benchmark:
+// table goes to stdout (header is printed before first benchmark), while test output stays
+// on stderr, so `./tests 2>/dev/null | scripts/gmintbl` gives median times even if tests
+// and benchmarks are mixed. Each call goes through function pointer, so it costs ~1-2ns.
+// If you measure something tiny, make @fn do it in loop
+typedef struct shi_bench_result {
+    double median; // ns per call
+    double min; // ns per call
+    uint64_t iters; // calls per repetition
+} shi_bench_result;
+SHITEST_DEF shi_bench_result shi_bench(const char* name, void (*fn)(void* ctx), void* ctx);
+
+// -- Performance regression gate --
+// Benchmark results can be stored in text file (one "name median_ns" per line, so names
+// can't contain whitespace or be longer than 63 bytes, shi_bench_check() fails on such) and later
+// runs can be compared against it, e.g:
+//   shi_baseline_load("perf.baseline");
+//   shi_bench_check("b64dec/4k", bench_b64dec, &ctx, 0.1);
+//   ...
+//   shi_baseline_save("perf.baseline");
+// shi_bench_check() is test case that fails (like any other assert) if median of
+// SHITEST_BASELINE_REPS repetitions is slower than baseline by more than @tolerance
+// (0.1 is 10%). Before failing, it measures again and takes better result, so single
+// noisy run doesn't fail the build. Benchmarks that aren't in baseline yet are just
+// recorded, and with SHITEST_BASELINE_UPDATE=1 env var all of them are re-recorded.
+// Existing values are never overwritten otherwise, so baseline doesn't drift with noise
+// Load baseline (if file doesn't exist, it is treated as empty)
+SHITEST_DEF void shi_baseline_load(const char* path);
+// Benchmark @fn and compare it against loaded baseline (or record it there)
+SHITEST_DEF void shi_bench_check(const char* name, void (*fn)(void* ctx), void* ctx, double tolerance);
+// Write baseline to file. Returns false if it can't
+SHITEST_DEF bool shi_baseline_save(const char* path);
+
+// Make compiler think that @x (variable or expression) is used, so computation of it
+// won't be optimized away. Without GNU asm, @x has to be variable
+#if defined(__GNUC__)
+ #define shi_do_not_optimize(x) __asm__ __volatile__("" : : "g"(x) : "memory")
+#else
+ #define shi_do_not_optimize(x) shi_escape((const void*)&(x))
+ SHITEST_DEF void shi_escape(const void* p);
+#endif
+
 // Separator, you can for example print it beetween groups of tests
 #define SHI_SEP "-----\n"
 
@@ -88,17 +135,112 @@ SHITEST_DEF unsigned shi_test_summary();
 // arguments (like printf vs vprintf). You can use it for defining custom assert routines.
 SHITEST_DEF void shi_assert_vf(bool cond, const char* fmt, va_list ap);
 
+// -- Threads --
+// If test spawns threads that use asserts, each of them should call shi_thread_begin()
+// before first assert and shi_thread_end() after last one. In between, failure msgs are
+// buffered and then printed at once (so output of threads don't interleave), and
+// failure is propagated into test that is currently running (so its shi_test_end() won't
+// print OK). Passing asserts are as cheap as in main thread (just a branch)
+SHITEST_DEF void shi_thread_begin();
+// Returns true if thread didn't fail any assert since shi_thread_begin()
+SHITEST_DEF bool shi_thread_end();
+
+// -- Allocation tracking --
+// Define SHITEST_ALLOC (along with SHITEST_IMPL) and link with
+// -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc,--wrap=free to count allocations done
+// during each test. It works with gcc/clang and glibc/musl (linker does the wrapping, so
+// no LD_PRELOAD is needed). Only calls from objects linked with these flags are seen
+// (e.g. strdup() inside libc isn't), in C++ operator new/delete are replaced so they
+// are counted too. Allocations from all threads are counted into current test.
+// shi_test_summary() prints tests with biggest peak heap usage. With fork runner stats
+// of registered tests are sent back to parent (except ones that crashed or timed out)
+#ifdef SHITEST_ALLOC
+typedef struct shi_alloc_stats {
+    size_t allocs; // count of malloc/calloc/realloc calls
+    size_t bytes; // bytes allocated by them (as reported by malloc_usable_size)
+    long long heap; // bytes allocated and not freed yet (can be < 0, if test frees older stuff)
+    long long peak; // max of @heap
+} shi_alloc_stats;
+// stats since start of current test
+SHITEST_DEF shi_alloc_stats shi_get_alloc_stats();
+// Assert that current test did at most @n allocations so far
+SHITEST_DEF void shi_assert_max_allocs(size_t n);
+// Assert that code between begin and end doesn't allocate (they can't be nested)
+SHITEST_DEF void shi_assert_no_alloc_begin();
+SHITEST_DEF void shi_assert_no_alloc_end();
+#endif
+
+// -- Fork-per-test runner --
+// Define SHITEST_FORK (along with SHITEST_IMPL, it needs posix) to enable it. Tests are
+// registered as functions and later shi_run_registered() runs each one in separate forked
+// process, @jobs at once (0 means number of cores). Output of each test is captured
+// (stderr only, stdout is left alone) and printed in registration order, and counters
+// are sent back to parent, so shi_test_summary() works as usual. Crashes and tests
+// running longer than SHITEST_TIMEOUT seconds (default 60, 0 disables it) are reported
+// as failures. Nothing stops you from mixing it with inline shi_test()/shi_test_end()
+#ifdef SHITEST_FORK
+// Register test. If @name is not NULL, @fn is test body and runner wraps it in
+// shi_test(name)/shi_test_end(). If it is NULL, @fn does shi_test() calls by itself
+// (so it can be group of tests, that are then run sequentially)
+SHITEST_DEF void shi_register(const char* name, void (*fn)(void* ctx), void* ctx);
+// Run all tests registered so far (and forget them). Returns count of failed tests
+SHITEST_DEF unsigned shi_run_registered(unsigned jobs);
+#endif
+
+// thread-local storage and atomic ops used by implementation
+#if defined(__GNUC__)
+ #define SHI_THREAD_LOCAL __thread
+ #define shi_atomic_add(ptr, val) __atomic_fetch_add((ptr), (val), __ATOMIC_RELAXED)
+ #define shi_atomic_load(ptr) __atomic_load_n((ptr), __ATOMIC_RELAXED)
+ #define shi_atomic_xchg(ptr, val) __atomic_exchange_n((ptr), (val), __ATOMIC_RELAXED)
+#elif defined(_MSC_VER)
+ #include <intrin.h>
+ #define SHI_THREAD_LOCAL __declspec(thread)
+ #define shi_atomic_add(ptr, val) _InterlockedExchangeAdd((volatile long*)(ptr), (val))
+ #define shi_atomic_load(ptr) (*(volatile unsigned*)(ptr))
+ #define shi_atomic_xchg(ptr, val) _InterlockedExchange((volatile long*)(ptr), (val))
+#else // no portable way in c99, so it just isn't thread safe
+ #define SHI_THREAD_LOCAL
+ #define shi_atomic_add(ptr, val) (*(ptr) += (val))
+ #define shi_atomic_load(ptr) (*(ptr))
+ #define shi_atomic_xchg(ptr, val) shi_xchg_plain((ptr), (val))
+ static unsigned shi_xchg_plain(unsigned* ptr, unsigned val) { unsigned old = *ptr; *ptr = val; return old; }
+#endif
+
 // private globals
-extern unsigned testCount;
-extern unsigned passCount;
-extern unsigned curTestStatus;
+extern unsigned shi_testcount; // atomic
+extern unsigned shi_passcount; // atomic
+extern SHI_THREAD_LOCAL unsigned shi_curTestStatus;
 
 #ifdef __cplusplus
  }
 #endif
-#endif /* SHLAG_PCG_H */
+#endif /* SHITEST_H */
 
 #ifdef SHITEST_IMPL
+// IMPLDEF is same as SHITEST_DEF, but with silenced warnings about unused static functions
+#if defined(__GNUC__)
+ #define SHITEST_IMPLDEF SHITEST_DEF __attribute__((unused))
+#else
+ #define SHITEST_IMPLDEF SHITEST_DEF
+#endif
+#include <stdlib.h>
+#if defined(_WIN32)
+ #include <windows.h>
+#else
+ #include <time.h>
+#endif
+
+#ifndef SHITEST_BENCH_TIME
+ #define SHITEST_BENCH_TIME 0.05
+#endif
+#ifndef SHITEST_BENCH_REPS
+ #define SHITEST_BENCH_REPS 5
+#endif
+#ifndef SHITEST_BASELINE_REPS
+ #define SHITEST_BASELINE_REPS 9 // more, so median is stable enough to fail build on it
+#endif
+
 // Use ANSI escapes for colored output if possible. Older versions of CMD doesn't support it,
 // so we disable colors on windows by default
 #if (defined(_WIN32) && !defined(SHITEST_FORCE_COLORS)) || defined(SHITEST_DISABLE_COLORS)
@@ -115,64 +257,760 @@ unsigned shi_testcount = 0;
 unsigned shi_passcount = 0;
 #define SHI_OK 0
 #define SHI_FAIL 1
-unsigned shi_curTestStatus = SHI_OK; // status of currently running test
+SHI_THREAD_LOCAL unsigned shi_curTestStatus = SHI_OK; // status of currently running test (in this thread)
+unsigned shi_failPrinted = 0; // atomic, whether " FAIL" was printed for current test
+unsigned shi_threadFails = 0; // atomic, count of failures during current test that test thread can't see
+
+// in threads between shi_thread_begin() and shi_thread_end(): buffered failure msgs
+SHI_THREAD_LOCAL bool shi_inThread = false;
+SHI_THREAD_LOCAL char* shi_threadBuf = NULL;
+SHI_THREAD_LOCAL size_t shi_threadBufLen = 0, shi_threadBufCap = 0;
+
+unsigned shi_benchcount = 0;
+
+#ifdef SHITEST_FORK
+ static void shi_send_status(bool inTest);
+ #define SHI_SEND_STATUS(inTest) shi_send_status(inTest)
+#else
+ #define SHI_SEND_STATUS(inTest) ((void)0)
+#endif
+#ifdef SHITEST_ALLOC
+ static void shi_alloc_test_begin(const char* fmt, va_list ap);
+ static void shi_alloc_test_end();
+ static void shi_alloc_summary();
+ #define SHI_ALLOC_TEST_BEGIN(fmt, ap) shi_alloc_test_begin(fmt, ap)
+ #define SHI_ALLOC_TEST_END() shi_alloc_test_end()
+ #define SHI_ALLOC_SUMMARY() shi_alloc_summary()
+#else
+ #define SHI_ALLOC_TEST_BEGIN(fmt, ap) ((void)0)
+ #define SHI_ALLOC_TEST_END() ((void)0)
+ #define SHI_ALLOC_SUMMARY() ((void)0)
+#endif
 
-SHITEST_DEF unsigned shi_test_summary()
+SHITEST_IMPLDEF unsigned shi_test_summary()
 {
     unsigned failcount = shi_testcount - shi_passcount;
+    SHI_ALLOC_SUMMARY();
+    if(shi_benchcount) fprintf(stderr, "benchmarks: %u, ", shi_benchcount);
     fprintf(stderr, "total: %u, passed: %u, failed: %u\n", 
             shi_testcount, shi_passcount, failcount);
     return failcount;
 }
 
-SHITEST_DEF void shi_test(const char* fmt, ...)
+// monotonic time in ns. In strict ISO mode (e.g -std=c99) posix clocks are hidden, so we
+// fall back to clock(), which is coarser and measures cpu time, but better than nothing
+static double shi_now()
+{
+#if defined(_WIN32)
+    LARGE_INTEGER t, freq;
+    QueryPerformanceCounter(&t);
+    QueryPerformanceFrequency(&freq);
+    return t.QuadPart * 1e9 / freq.QuadPart;
+#elif defined(CLOCK_MONOTONIC)
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e9 + t.tv_nsec;
+#else
+    return clock() * (1e9 / CLOCKS_PER_SEC);
+#endif
+}
+
+#if !defined(__GNUC__)
+const void* volatile shi_escaped;
+SHITEST_IMPLDEF void shi_escape(const void* p)
+{
+    shi_escaped = p;
+}
+#endif
+
+// run fn iters times, return elapsed ns. Pointer is volatile, so compiler can't inline
+// fn (and optimize it out of loop) even if it sees it
+static double shi_bench_run(void (*fn)(void*), void* ctx, uint64_t iters)
+{
+    void (*volatile vfn)(void*) = fn;
+    double t = shi_now();
+    for(uint64_t i = 0; i < iters; ++i) vfn(ctx);
+    return shi_now() - t;
+}
+
+static int shi_cmp_double(const void* a, const void* b)
+{
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+#define SHI_MAX_REPS 64
+
+static shi_bench_result shi_bench_reps(const char* name, void (*fn)(void* ctx), void* ctx, unsigned reps)
+{
+    shi_bench_result res;
+    if(reps < 1) reps = 1;
+    if(reps > SHI_MAX_REPS) reps = SHI_MAX_REPS;
+    // calibrate: grow iteration count until it takes noticeable time, then extrapolate
+    uint64_t iters = 1;
+    double t;
+    while((t = shi_bench_run(fn, ctx, iters)) < SHITEST_BENCH_TIME * 1e9 / 10) iters *= 10;
+    res.iters = iters * (SHITEST_BENCH_TIME * 1e9 / t) + 1;
+    double times[SHI_MAX_REPS];
+    for(unsigned i = 0; i < reps; ++i) {
+        times[i] = shi_bench_run(fn, ctx, res.iters) / res.iters;
+    }
+    qsort(times, reps, sizeof(double), shi_cmp_double);
+    res.min = times[0];
+    res.median = reps % 2 ? times[reps/2] : (times[reps/2 - 1] + times[reps/2]) / 2;
+    if(shi_benchcount++ == 0) {
+        fputs("----------------------------------------------------------------------------\n", stdout);
+        printf("%-40s %13s %13s %10s\n", "Benchmark", "Median", "Min", "Iterations");
+        fputs("----------------------------------------------------------------------------\n", stdout);
+    }
+    printf("%-40s %10.2f ns %10.2f ns %10llu\n", name, res.median, res.min, (unsigned long long)res.iters);
+    fflush(stdout); // so it isn't reordered with test output, when both go to same file
+    return res;
+}
+
+SHITEST_IMPLDEF shi_bench_result shi_bench(const char* name, void (*fn)(void* ctx), void* ctx)
+{
+    return shi_bench_reps(name, fn, ctx, SHITEST_BENCH_REPS);
+}
+
+// baseline entries, loaded from file and/or measured
+typedef struct shi_baseline_entry {
+    char name[64];
+    double median; // ns per call
+} shi_baseline_entry;
+shi_baseline_entry* shi_baseline = NULL;
+size_t shi_baselineLen = 0, shi_baselineCap = 0;
+
+static shi_baseline_entry* shi_baseline_find(const char* name)
+{
+    for(size_t i = 0; i < shi_baselineLen; ++i) {
+        // names are truncated to fit in entry
+        if(strncmp(shi_baseline[i].name, name, sizeof(shi_baseline[i].name) - 1) == 0) return &shi_baseline[i];
+    }
+    return NULL;
+}
+
+static shi_baseline_entry* shi_baseline_add(const char* name)
+{
+    if(shi_baselineLen == shi_baselineCap) {
+        size_t cap = shi_baselineCap ? shi_baselineCap * 2 : 16;
+        shi_baseline_entry* entries = (shi_baseline_entry*)realloc(shi_baseline, cap * sizeof(shi_baseline_entry));
+        if(!entries) return NULL;
+        shi_baseline = entries;
+        shi_baselineCap = cap;
+    }
+    shi_baseline_entry* e = &shi_baseline[shi_baselineLen++];
+    snprintf(e->name, sizeof(e->name), "%s", name);
+    e->median = 0;
+    return e;
+}
+
+static bool shi_baseline_updating()
+{
+    const char* env = getenv("SHITEST_BASELINE_UPDATE");
+    return env && *env && strcmp(env, "0") != 0;
+}
+
+SHITEST_IMPLDEF void shi_baseline_load(const char* path)
+{
+    shi_baselineLen = 0;
+    FILE* f = fopen(path, "r");
+    if(!f) return; // no baseline yet, everything will be recorded
+    char line[256], name[64];
+    double median;
+    while(fgets(line, sizeof(line), f)) {
+        if(line[0] == '#') continue;
+        if(sscanf(line, "%63s %lf", name, &median) != 2 || median <= 0) continue;
+        shi_baseline_entry* e = shi_baseline_find(name);
+        if(!e) e = shi_baseline_add(name);
+        if(e) e->median = median;
+    }
+    fclose(f);
+}
+
+SHITEST_IMPLDEF bool shi_baseline_save(const char* path)
+{
+    FILE* f = fopen(path, "w");
+    if(!f) return false;
+    fputs("# shitest baseline: name median_ns\n", f);
+    for(size_t i = 0; i < shi_baselineLen; ++i) {
+        fprintf(f, "%s %.4f\n", shi_baseline[i].name, shi_baseline[i].median);
+    }
+    free(shi_baseline);
+    shi_baseline = NULL;
+    shi_baselineLen = shi_baselineCap = 0;
+    return fclose(f) == 0;
+}
+
+SHITEST_IMPLDEF void shi_bench_check(const char* name, void (*fn)(void* ctx), void* ctx, double tolerance)
+{
+    // it wouldn't be loaded back (so never gated), or would be mixed up with other one
+    if(!*name || strpbrk(name, " \t\n\v\f\r") || strlen(name) >= sizeof(shi_baseline[0].name)) {
+        shi_test("\"%s\" is valid baseline name", name);
+        shi_assert_f(false, "baseline names can't be empty, contain whitespace or be longer than %d bytes",
+                (int)sizeof(shi_baseline[0].name) - 1);
+        shi_test_end();
+        return;
+    }
+    shi_bench_result res = shi_bench_reps(name, fn, ctx, SHITEST_BASELINE_REPS);
+    shi_baseline_entry* e = shi_baseline_find(name);
+    if(!e || shi_baseline_updating()) { // nothing to compare with, just record it
+        if(!e) e = shi_baseline_add(name);
+        if(e) e->median = res.median;
+        shi_test("%s recorded into baseline", name);
+        shi_test_end();
+        return;
+    }
+    const double limit = e->median * (1 + tolerance);
+    if(res.median > limit) { // can be noise (e.g other process was running), so measure again
+        shi_bench_result retry = shi_bench_reps(name, fn, ctx, SHITEST_BASELINE_REPS);
+        if(retry.median < res.median) res = retry;
+    }
+    shi_test("%s is not slower than baseline", name);
+    shi_assert_f(res.median <= limit, "median %.2f ns is %.1f%% slower than baseline %.2f ns (tolerance %.1f%%)",
+            res.median, (res.median / e->median - 1) * 100, e->median, tolerance * 100);
+    shi_test_end();
+}
+
+SHITEST_IMPLDEF void shi_test(const char* fmt, ...)
 {
     va_list args;
     va_start(args, fmt);
+    SHI_ALLOC_TEST_BEGIN(fmt, args);
     vfprintf(stderr, fmt, args);
     va_end(args);
 
     fputs(":", stderr);
-    ++shi_testcount;
+    shi_atomic_add(&shi_testcount, 1);
     shi_curTestStatus = SHI_OK;
+    shi_atomic_xchg(&shi_failPrinted, 0);
+    shi_atomic_xchg(&shi_threadFails, 0);
+    SHI_SEND_STATUS(true);
+}
+SHITEST_IMPLDEF void shi_test_end()
+{
+    if(shi_curTestStatus == SHI_OK && shi_atomic_load(&shi_threadFails) == 0) {
+        fputs(SHI_GREEN " OK\n" SHI_RESET, stderr);
+        shi_atomic_add(&shi_passcount, 1);
+    }
+    SHI_ALLOC_TEST_END();
+    SHI_SEND_STATUS(false);
 }
-SHITEST_DEF void shi_test_end()
+
+// append formatted failure msg to thread's buffer
+static void shi_thread_vappend(const char* fmt, va_list ap)
 {
-    if(shi_curTestStatus == SHI_OK) {
-        fputs(SHI_GREEN " OK\n" SHI_RESET, stderr); ++shi_passcount;
+    va_list ap2;
+    va_copy(ap2, ap);
+    int len = vsnprintf(NULL, 0, fmt, ap2);
+    va_end(ap2);
+    if(len < 0) return;
+    size_t need = shi_threadBufLen + len + 3; // " ", "\n" and nul
+    if(need > shi_threadBufCap) {
+        char* buf = (char*)realloc(shi_threadBuf, need * 2);
+        if(!buf) return; // we lose msg, but failure is still recorded
+        shi_threadBuf = buf;
+        shi_threadBufCap = need * 2;
     }
+    shi_threadBuf[shi_threadBufLen++] = ' ';
+    vsnprintf(shi_threadBuf + shi_threadBufLen, len + 1, fmt, ap);
+    shi_threadBufLen += len;
+    shi_threadBuf[shi_threadBufLen++] = '\n';
 }
-SHITEST_DEF void shi_assert_vf(bool cond, const char* fmt, va_list ap)
+
+SHITEST_IMPLDEF void shi_assert_vf(bool cond, const char* fmt, va_list ap)
 {
     if(cond) return;
-    if(shi_curTestStatus != SHI_FAIL) { // avoid duplication
-        fputs(SHI_RED" FAIL\n"SHI_RESET, stderr);
+    shi_curTestStatus = SHI_FAIL;
+    if(shi_inThread) {
+        shi_thread_vappend(fmt, ap);
+        return;
+    }
+    // status is thread local, so if it's some other thread (without shi_thread_begin()),
+    // test thread wouldn't know about failure. Shared counter is checked by shi_test_end()
+    shi_atomic_add(&shi_threadFails, 1);
+    if(shi_atomic_xchg(&shi_failPrinted, 1) == 0) { // avoid duplication
+        fputs(SHI_RED " FAIL\n" SHI_RESET, stderr);
     }
     fputs(" ", stderr);
-    shi_curTestStatus = SHI_FAIL;
     vfprintf(stderr, fmt, ap);
     fputs("\n", stderr);
 }
-SHITEST_DEF void shi_assert_f(bool cond, const char* fmt, ...)
+
+SHITEST_IMPLDEF void shi_thread_begin()
+{
+    shi_inThread = true;
+    shi_curTestStatus = SHI_OK;
+    shi_threadBufLen = 0;
+}
+
+SHITEST_IMPLDEF bool shi_thread_end()
+{
+    shi_inThread = false;
+    if(shi_curTestStatus == SHI_OK) return true;
+    shi_atomic_add(&shi_threadFails, 1);
+    // whole msg goes in single fwrite, and stdio locks stream for it, so it won't interleave
+    static const char failMsg[] = SHI_RED " FAIL\n" SHI_RESET;
+    const size_t failLen = shi_atomic_xchg(&shi_failPrinted, 1) == 0 ? sizeof(failMsg) - 1 : 0;
+    char* out = (char*)malloc(failLen + shi_threadBufLen);
+    if(out) {
+        memcpy(out, failMsg, failLen);
+        if(shi_threadBufLen) memcpy(out + failLen, shi_threadBuf, shi_threadBufLen);
+        fwrite(out, 1, failLen + shi_threadBufLen, stderr);
+        free(out);
+    }
+    free(shi_threadBuf);
+    shi_threadBuf = NULL;
+    shi_threadBufLen = shi_threadBufCap = 0;
+    return false;
+}
+SHITEST_IMPLDEF void shi_assert_f(bool cond, const char* fmt, ...)
 {
     va_list ap; va_start(ap, fmt); 
     shi_assert_vf(cond, fmt, ap);
     va_end(ap);
 }
-SHITEST_DEF void shi_assert_streq_f(const char* s1, const char* s2, const char* fmt, ...)
+SHITEST_IMPLDEF void shi_assert_streq_f(const char* s1, const char* s2, const char* fmt, ...)
 {
     va_list ap; va_start(ap, fmt); 
     shi_assert_vf(strcmp(s1, s2) == 0, fmt, ap);
     va_end(ap);
 }
-SHITEST_DEF void shi_assert_memeq_f(const void* mem1, const void* mem2, size_t n, const char* fmt, ...)
+SHITEST_IMPLDEF void shi_assert_memeq_f(const void* mem1, const void* mem2, size_t n, const char* fmt, ...)
 {
     va_list ap; va_start(ap, fmt); 
     shi_assert_vf(memcmp(mem1, mem2, n) == 0, fmt, ap);
     va_end(ap);
 }
-SHITEST_DEF void shi_assert_streq(const char* expected, const char* actual)
+SHITEST_IMPLDEF void shi_assert_streq(const char* expected, const char* actual)
 {
     return shi_assert_streq_f(expected, actual, "expected: \"%s\", actual: \"%s\"", expected, actual);
 }
+
+#ifdef SHITEST_ALLOC
+#if !defined(__GNUC__)
+ #error "SHITEST_ALLOC needs gcc or clang"
+#endif
+#include <malloc.h>
+#ifdef __cplusplus
+ #include <new>
+ extern "C" {
+#endif
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t n, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+void __real_free(void* ptr);
+
+#ifndef SHITEST_ALLOC_TOP
+ #define SHITEST_ALLOC_TOP 10 // how many tests are printed in summary
+#endif
+
+shi_alloc_stats shi_allocStats = {0, 0, 0, 0}; // fields are atomic, reset by shi_test()
+size_t shi_noAllocStart = 0, shi_noAllocBytes = 0; // stats at shi_assert_no_alloc_begin()
+
+// finished tests, for summary
+typedef struct shi_alloc_record {
+    char name[64];
+    shi_alloc_stats stats;
+} shi_alloc_record;
+shi_alloc_record* shi_allocRecords = NULL;
+size_t shi_allocRecordsLen = 0, shi_allocRecordsCap = 0;
+char shi_allocCurName[64];
+
+static void shi_count_alloc(void* ptr)
+{
+    if(!ptr) return;
+    size_t size = malloc_usable_size(ptr);
+    shi_atomic_add(&shi_allocStats.allocs, 1);
+    shi_atomic_add(&shi_allocStats.bytes, size);
+    long long heap = shi_atomic_add(&shi_allocStats.heap, (long long)size) + size;
+    long long peak = shi_atomic_load(&shi_allocStats.peak);
+    while(heap > peak && !__atomic_compare_exchange_n(&shi_allocStats.peak, &peak, heap,
+                true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {}
+}
+
+static void shi_count_free(void* ptr)
+{
+    if(ptr) shi_atomic_add(&shi_allocStats.heap, -(long long)malloc_usable_size(ptr));
+}
+
+void* __wrap_malloc(size_t size)
+{
+    void* ptr = __real_malloc(size);
+    shi_count_alloc(ptr);
+    return ptr;
+}
+void* __wrap_calloc(size_t n, size_t size)
+{
+    void* ptr = __real_calloc(n, size);
+    shi_count_alloc(ptr);
+    return ptr;
+}
+void* __wrap_realloc(void* ptr, size_t size)
+{
+    size_t oldSize = ptr ? malloc_usable_size(ptr) : 0;
+    void* newPtr = __real_realloc(ptr, size);
+    if(!newPtr && size) return newPtr; // failed, old block is untouched
+    shi_atomic_add(&shi_allocStats.heap, -(long long)oldSize);
+    shi_count_alloc(newPtr);
+    return newPtr;
+}
+void __wrap_free(void* ptr)
+{
+    shi_count_free(ptr);
+    __real_free(ptr);
+}
+#ifdef __cplusplus
+ } // extern "C"
+// replaceable operators from libstdc++ call malloc from inside of it, so we wouldn't see them
+void* operator new(size_t size)
+{
+    void* ptr = malloc(size ? size : 1);
+ #if defined(__cpp_exceptions) || defined(__EXCEPTIONS)
+    if(!ptr) throw std::bad_alloc();
+ #else
+    if(!ptr) abort();
+ #endif
+    return ptr;
+}
+void* operator new[](size_t size) { return operator new(size); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return malloc(size ? size : 1); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return malloc(size ? size : 1); }
+void operator delete(void* ptr) noexcept { free(ptr); }
+void operator delete[](void* ptr) noexcept { free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { free(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { free(ptr); }
+#endif
+
+static void shi_alloc_test_begin(const char* fmt, va_list ap)
+{
+    va_list ap2;
+    va_copy(ap2, ap);
+    vsnprintf(shi_allocCurName, sizeof(shi_allocCurName), fmt, ap2);
+    va_end(ap2);
+    shi_atomic_xchg(&shi_allocStats.allocs, 0);
+    shi_atomic_xchg(&shi_allocStats.bytes, 0);
+    shi_atomic_xchg(&shi_allocStats.heap, 0);
+    shi_atomic_xchg(&shi_allocStats.peak, 0);
+}
+
+// also used by fork runner, for records sent by test processes
+static void shi_alloc_add_record(const shi_alloc_record* rec)
+{
+    if(shi_allocRecordsLen == shi_allocRecordsCap) { // not counted, we aren't testing ourself
+        size_t cap = shi_allocRecordsCap ? shi_allocRecordsCap * 2 : 64;
+        void* records = __real_realloc(shi_allocRecords, cap * sizeof(shi_alloc_record));
+        if(!records) return;
+        shi_allocRecords = (shi_alloc_record*)records;
+        shi_allocRecordsCap = cap;
+    }
+    shi_allocRecords[shi_allocRecordsLen++] = *rec;
+}
+
+static void shi_alloc_test_end()
+{
+    shi_alloc_record rec;
+    memcpy(rec.name, shi_allocCurName, sizeof(rec.name));
+    rec.stats = shi_get_alloc_stats();
+    shi_alloc_add_record(&rec);
+}
+
+static int shi_cmp_alloc_record(const void* a, const void* b)
+{
+    long long x = ((const shi_alloc_record*)a)->stats.peak, y = ((const shi_alloc_record*)b)->stats.peak;
+    return (x < y) - (x > y); // descending
+}
+
+static void shi_alloc_summary()
+{
+    if(!shi_allocRecordsLen) return;
+    qsort(shi_allocRecords, shi_allocRecordsLen, sizeof(shi_alloc_record), shi_cmp_alloc_record);
+    size_t n = shi_allocRecordsLen < SHITEST_ALLOC_TOP ? shi_allocRecordsLen : SHITEST_ALLOC_TOP;
+    fprintf(stderr, "peak heap usage (top %zu of %zu tests):\n", n, shi_allocRecordsLen);
+    for(size_t i = 0; i < n; ++i) {
+        const shi_alloc_stats* st = &shi_allocRecords[i].stats;
+        fprintf(stderr, " %s: %lld B peak, %zu allocs, %zu B allocated\n",
+                shi_allocRecords[i].name, st->peak, st->allocs, st->bytes);
+    }
+    __real_free(shi_allocRecords);
+    shi_allocRecords = NULL;
+    shi_allocRecordsLen = shi_allocRecordsCap = 0;
+}
+
+SHITEST_IMPLDEF shi_alloc_stats shi_get_alloc_stats()
+{
+    shi_alloc_stats st;
+    st.allocs = shi_atomic_load(&shi_allocStats.allocs);
+    st.bytes = shi_atomic_load(&shi_allocStats.bytes);
+    st.heap = shi_atomic_load(&shi_allocStats.heap);
+    st.peak = shi_atomic_load(&shi_allocStats.peak);
+    return st;
+}
+
+SHITEST_IMPLDEF void shi_assert_max_allocs(size_t n)
+{
+    size_t allocs = shi_atomic_load(&shi_allocStats.allocs);
+    shi_assert_f(allocs <= n, "expected at most %zu allocations, got %zu", n, allocs);
+}
+
+SHITEST_IMPLDEF void shi_assert_no_alloc_begin()
+{
+    shi_noAllocStart = shi_atomic_load(&shi_allocStats.allocs);
+    shi_noAllocBytes = shi_atomic_load(&shi_allocStats.bytes);
+}
+
+SHITEST_IMPLDEF void shi_assert_no_alloc_end()
+{
+    size_t allocs = shi_atomic_load(&shi_allocStats.allocs) - shi_noAllocStart;
+    size_t bytes = shi_atomic_load(&shi_allocStats.bytes) - shi_noAllocBytes;
+    shi_assert_f(allocs == 0, "expected no allocations, got %zu (%zu B)", allocs, bytes);
+}
+#endif // SHITEST_ALLOC
+
+#ifdef SHITEST_FORK
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#ifndef SHITEST_TIMEOUT
+ #define SHITEST_TIMEOUT 60
+#endif
+
+// counters sent from test process to runner, after each shi_test() and shi_test_end()
+typedef struct shi_status {
+    unsigned testcount, passcount;
+    unsigned inTest; // 1 if shi_test() was called, but shi_test_end() not yet
+#ifdef SHITEST_ALLOC
+    unsigned hasAlloc; // 1 if @alloc holds stats of test that just ended
+    shi_alloc_record alloc; // still way smaller than PIPE_BUF
+#endif
+} shi_status;
+
+enum shi_test_state { SHI_PENDING, SHI_RUNNING, SHI_DONE }; // outside struct, for C++
+
+typedef struct shi_registered {
+    const char* name;
+    void (*fn)(void*);
+    void* ctx;
+    // runner state
+    enum shi_test_state state;
+    pid_t pid;
+    int outfd, statusfd; // read ends of pipes, -1 after EOF
+    char* out; // captured stderr
+    size_t outlen, outcap;
+    shi_status status; // last received status
+    double start; // ns
+    bool timedOut;
+    int exitStatus; // from waitpid()
+} shi_registered;
+
+static shi_registered* shi_registry = NULL;
+static size_t shi_registryLen = 0, shi_registryCap = 0;
+static int shi_statusfd = -1; // in test process: write end of status pipe
+
+static void shi_send_status(bool inTest)
+{
+    if(shi_statusfd < 0) return;
+    shi_status st;
+    memset(&st, 0, sizeof(st));
+    st.testcount = shi_testcount;
+    st.passcount = shi_passcount;
+    st.inTest = inTest;
+#ifdef SHITEST_ALLOC
+    if(!inTest && shi_allocRecordsLen) { // test process never prints summary, runner does
+        st.hasAlloc = 1;
+        st.alloc = shi_allocRecords[--shi_allocRecordsLen];
+    }
+#endif
+    // status is smaller than PIPE_BUF, so write is atomic. If runner is gone, we don't care
+    ssize_t ret = write(shi_statusfd, &st, sizeof(st));
+    (void)ret;
+}
+
+static void* shi_xrealloc(void* p, size_t size)
+{
+    p = realloc(p, size);
+    if(!p) {
+        fputs("shitest: out of memory\n", stderr);
+        abort();
+    }
+    return p;
+}
+
+SHITEST_IMPLDEF void shi_register(const char* name, void (*fn)(void* ctx), void* ctx)
+{
+    if(shi_registryLen == shi_registryCap) {
+        shi_registryCap = shi_registryCap ? shi_registryCap * 2 : 16;
+        shi_registry = (shi_registered*)shi_xrealloc(shi_registry, shi_registryCap * sizeof(shi_registered));
+    }
+    shi_registered* t = &shi_registry[shi_registryLen++];
+    memset(t, 0, sizeof(*t));
+    t->name = name;
+    t->fn = fn;
+    t->ctx = ctx;
+    t->outfd = t->statusfd = -1;
+}
+
+// body of forked process
+static void shi_child(shi_registered* t, int outfd, int statusfd)
+{
+    dup2(outfd, STDERR_FILENO);
+    close(outfd);
+    shi_statusfd = statusfd;
+    shi_testcount = shi_passcount = 0;
+#ifdef SHITEST_ALLOC
+    shi_allocRecordsLen = 0; // these are parent's, it already has them
+#endif
+    shi_send_status(false);
+    if(t->name) shi_test("%s", t->name);
+    t->fn(t->ctx);
+    if(t->name) shi_test_end();
+    fflush(stdout);
+    _exit(0); // don't run atexit handlers of parent
+}
+
+static void shi_spawn(shi_registered* t)
+{
+    int out[2], status[2];
+    t->state = SHI_RUNNING;
+    t->start = shi_now();
+    if(pipe(out) == 0) {
+        if(pipe(status) == 0) {
+            fflush(stdout); fflush(stderr); // otherwise buffered stuff would be printed twice
+            t->pid = fork();
+            if(t->pid == 0) {
+                close(out[0]); close(status[0]);
+                shi_child(t, out[1], status[1]);
+            }
+            close(out[1]); close(status[1]);
+            if(t->pid > 0) {
+                t->outfd = out[0]; t->statusfd = status[0];
+                return;
+            }
+            close(status[0]);
+        }
+        close(out[0]);
+    }
+    t->exitStatus = errno;
+    t->pid = -1;
+    t->state = SHI_DONE;
+}
+
+// read whatever is available in @fd, return false on EOF (or error)
+static bool shi_read_some(int fd, shi_registered* t, bool isStatus)
+{
+    char buf[4096];
+    ssize_t n = read(fd, buf, isStatus ? sizeof(buf) / sizeof(shi_status) * sizeof(shi_status) : sizeof(buf));
+    if(n < 0) return errno == EINTR || errno == EAGAIN;
+    if(n == 0) return false;
+    if(isStatus) { // writes are atomic, so we always get whole records. Newest one matters
+        memcpy(&t->status, buf + n - sizeof(shi_status), sizeof(shi_status));
+#ifdef SHITEST_ALLOC
+        for(ssize_t off = 0; off < n; off += sizeof(shi_status)) { // but all alloc stats do
+            shi_status st;
+            memcpy(&st, buf + off, sizeof(st));
+            if(st.hasAlloc) shi_alloc_add_record(&st.alloc);
+        }
+#endif
+    } else {
+        if(t->outlen + n > t->outcap) {
+            t->outcap = (t->outlen + n) * 2;
+            t->out = (char*)shi_xrealloc(t->out, t->outcap);
+        }
+        memcpy(t->out + t->outlen, buf, n);
+        t->outlen += n;
+    }
+    return true;
+}
+
+// print captured output and update counters
+static void shi_report(shi_registered* t)
+{
+    fwrite(t->out, 1, t->outlen, stderr);
+    const bool midLine = t->outlen > 0 && t->out[t->outlen - 1] != '\n';
+    free(t->out);
+    bool exitedOk = t->pid > 0 && !t->timedOut && WIFEXITED(t->exitStatus) && WEXITSTATUS(t->exitStatus) == 0;
+    shi_atomic_add(&shi_testcount, t->status.testcount);
+    shi_atomic_add(&shi_passcount, t->status.passcount);
+    if(exitedOk && !t->status.inTest) return;
+    // it died mid test (which is already counted as failed), or outside of any test
+    // (then we count it as extra failed test)
+    if(!t->status.inTest) {
+        fprintf(stderr, "%s:", t->name ? t->name : "(test group)");
+        shi_atomic_add(&shi_testcount, 1);
+    }
+    if(!t->status.inTest || midLine) {
+        fputs(SHI_RED " FAIL\n" SHI_RESET, stderr);
+    }
+    if(t->pid < 0) fprintf(stderr, " can't run test process: %s\n", strerror(t->exitStatus));
+    else if(t->timedOut) fprintf(stderr, " timed out after %d s\n", SHITEST_TIMEOUT);
+    else if(WIFSIGNALED(t->exitStatus)) {
+        fprintf(stderr, " crashed with signal %d (%s)\n", WTERMSIG(t->exitStatus), strsignal(WTERMSIG(t->exitStatus)));
+    } else if(WEXITSTATUS(t->exitStatus) != 0) {
+        fprintf(stderr, " exited with status %d\n", WEXITSTATUS(t->exitStatus));
+    } else fputs(" test process exited without calling shi_test_end()\n", stderr);
+}
+
+SHITEST_IMPLDEF unsigned shi_run_registered(unsigned jobs)
+{
+    const unsigned failedBefore = shi_testcount - shi_passcount;
+    if(jobs == 0) {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        jobs = cores > 0 ? cores : 1;
+    }
+    struct pollfd* fds = (struct pollfd*)shi_xrealloc(NULL, 2 * jobs * sizeof(struct pollfd));
+    shi_registered** owners = (shi_registered**)shi_xrealloc(NULL, 2 * jobs * sizeof(shi_registered*));
+    size_t next = 0, printed = 0; // tests before @next are spawned, before @printed reported
+    unsigned running = 0;
+    while(printed < shi_registryLen) {
+        for(; running < jobs && next < shi_registryLen; ++next) {
+            shi_spawn(&shi_registry[next]);
+            running += shi_registry[next].state == SHI_RUNNING;
+        }
+        // wait for output, at most 100ms so timeouts are checked regularly
+        nfds_t nfds = 0;
+        for(size_t i = printed; i < next; ++i) {
+            shi_registered* t = &shi_registry[i];
+            if(t->outfd >= 0) { fds[nfds].fd = t->outfd; fds[nfds].events = POLLIN; owners[nfds++] = t; }
+            if(t->statusfd >= 0) { fds[nfds].fd = t->statusfd; fds[nfds].events = POLLIN; owners[nfds++] = t; }
+        }
+        if(poll(fds, nfds, 100) > 0) {
+            for(nfds_t i = 0; i < nfds; ++i) {
+                if(!fds[i].revents) continue;
+                shi_registered* t = owners[i];
+                bool isStatus = fds[i].fd == t->statusfd;
+                if(!shi_read_some(fds[i].fd, t, isStatus)) {
+                    close(fds[i].fd);
+                    if(isStatus) t->statusfd = -1; else t->outfd = -1;
+                }
+            }
+        }
+        // both pipes closed means process is (almost) dead, reap it. Kill ones that take too long
+        for(size_t i = printed; i < next; ++i) {
+            shi_registered* t = &shi_registry[i];
+            if(t->state != SHI_RUNNING) continue;
+            if(t->outfd < 0 && t->statusfd < 0) {
+                while(waitpid(t->pid, &t->exitStatus, 0) < 0 && errno == EINTR) {}
+                t->state = SHI_DONE;
+                --running;
+            } else if(SHITEST_TIMEOUT > 0 && !t->timedOut && shi_now() - t->start > SHITEST_TIMEOUT * 1e9) {
+                kill(t->pid, SIGKILL);
+                t->timedOut = true;
+            }
+        }
+        // print finished tests in order
+        for(; printed < next && shi_registry[printed].state == SHI_DONE; ++printed) {
+            shi_report(&shi_registry[printed]);
+        }
+    }
+    free(fds);
+    free(owners);
+    free(shi_registry);
+    shi_registry = NULL;
+    shi_registryLen = shi_registryCap = 0;
+    return shi_testcount - shi_passcount - failedBefore;
+}
+#endif // SHITEST_FORK
 #endif // SHITEST_IMPL
@@ -4,10 +4,16 @@
  * no need for another buffer). I haven't yet seen C lib able to do that.
  * Inspired by: https://github.com/dotnet/corefxlab/pull/834/files
  *
- * used namespaces: shlag_b64, SHLAG_B64
+ * Supported encodings (RFC 4648): base64, base64url (unpadded), base32, base16.
+ * All of them are driven by one block engine, and their lookup tables are generated
+ * at compile time from alphabet definitions. If you compile with SSSE3 (base64) or
+ * SSE2 (base16) enabled, vectorized kernels are used for bulk of the data.
+ *
+ * used namespaces: shlag_b64, SHLAG_B64, shlag_b32, SHLAG_B32, shlag_b16, SHLAG_B16,
+ * shlag_btt, SHLAG_BTT
  *
  * In *one* of C or C++ file, you have to define SHLAG_B64_IMPL before including
- * shlag_btt.h. See `shlag/tests/shlag_btt.c` 
+ * shlag_b64.h. See `shlag/tests/b64test.c`
  */
 
 #ifndef SHLAG_B64_H
@@ -21,6 +27,15 @@
  #define SHLAG_B64_DEF
 #endif
 
+// Define SHLAG_B64_WIDE to make base64 scalar code use wide lookup tables: 12-bit indexed
+// encode table (two chars per lookup) and pre-shifted 32-bit decode tables (block is
+// decoded with 4 OR'ed lookups, validation included). Useful on targets without SIMD.
+// It costs 24KB of tables. It is ignored when SSSE3 kernels are enabled
+// On my machine (x86-64 without -mssse3, gcc 12 -O2, 1MB of binary data, best of 300 runs,
+// TSC cycles per binary byte):
+//   default: enc 1.18, dec 1.44
+//   wide:    enc 0.84, dec 0.91
+
 #ifdef __cplusplus
  extern "C" {
 #endif
@@ -43,6 +58,28 @@ SHLAG_B64_DEF void shlag_b64enc(const uint8_t* in, int64_t inSize, char* out);
 // On success returns count of written bytes. On fail returns negative number
 SHLAG_B64_DEF int64_t shlag_b64dec(const char* in, int64_t inLen, uint8_t* out);
 
+// base64url ('-' and '_' instead of '+' and '/'). Encoder doesn't emit padding, as
+// it is usually omitted in urls and tokens. Decoder accepts both padded and unpadded input.
+// Semantics are same as for shlag_b64enc() and shlag_b64dec()
+#define SHLAG_B64URL_ENCSIZE(n) ((int64_t)(n)/3*4 + ((int64_t)(n)%3*4 + 2)/3 + 1)
+#define SHLAG_B64URL_DECSIZE(len) SHLAG_B64_DECSIZE(len)
+SHLAG_B64_DEF void shlag_b64urlenc(const uint8_t* in, int64_t inSize, char* out);
+SHLAG_B64_DEF int64_t shlag_b64urldec(const char* in, int64_t inLen, uint8_t* out);
+
+// base32 with padding. Semantics are same as for shlag_b64enc() and shlag_b64dec()
+#define SHLAG_B32_ENCSIZE(n) (((int64_t)(n) + 4)/5*8 + 1)
+#define SHLAG_B32_DECSIZE(len) ((int64_t)(len)*5/8)
+SHLAG_B64_DEF void shlag_b32enc(const uint8_t* in, int64_t inSize, char* out);
+SHLAG_B64_DEF int64_t shlag_b32dec(const char* in, int64_t inLen, uint8_t* out);
+
+// base16 (hex). shlag_b16enc() outputs uppercase digits (as RFC says), shlag_b16enc_lower()
+// lowercase ones (as sha256sum and friends do). Decoder accepts both
+#define SHLAG_B16_ENCSIZE(n) ((int64_t)(n)*2 + 1)
+#define SHLAG_B16_DECSIZE(len) ((int64_t)(len)/2)
+SHLAG_B64_DEF void shlag_b16enc(const uint8_t* in, int64_t inSize, char* out);
+SHLAG_B64_DEF void shlag_b16enc_lower(const uint8_t* in, int64_t inSize, char* out);
+SHLAG_B64_DEF int64_t shlag_b16dec(const char* in, int64_t inLen, uint8_t* out);
+
 #ifdef __cplusplus
  }
 #endif
@@ -51,113 +88,487 @@ SHLAG_B64_DEF int64_t shlag_b64dec(const char* in, int64_t inLen, uint8_t* out);
 // private stuff
 
 #ifdef SHLAG_B64_IMPL
-// lookup table for converting six-bit binary into base64 character
-static const char* shlag_b64chars = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+#include <string.h>
+#if defined(__SSSE3__)
+ #include <tmmintrin.h>
+#elif defined(__SSE2__)
+ #include <emmintrin.h>
+#endif
+
+#define SHLAG_B64_MAX_VALID 63 // 0b00111111
+#define SHLAG_B64_BAD 64    // 0b01000000
+#define SHLAG_B64_PAD 128   // 0b10000000
+// BAD and PAD are bitflags used for input validation. All encodings share them
+
+// Engine funcs have to be inlined into wrappers, as this is what specializes them
+// Loops over block have constant trip count, but gcc -O2 doesn't unroll them by itself
+#if defined(__GNUC__)
+ #define SHLAG_BTT_INLINE static inline __attribute__((always_inline))
+ #define SHLAG_BTT_UNROLL _Pragma("GCC unroll 8")
+#else
+ #define SHLAG_BTT_INLINE static inline
+ #define SHLAG_BTT_UNROLL
+#endif
+
+// -- alphabet definitions --
+// Each alphabet is pair of macros: value -> char and char -> value (or BAD/PAD flag).
+// SHLAG_BTT_TBL* expand them into lookup tables, so there is no need for generator scripts
+
+#define SHLAG_BTT_TBL4(f, i) f(i), f((i)+1), f((i)+2), f((i)+3)
+#define SHLAG_BTT_TBL16(f, i) SHLAG_BTT_TBL4(f, i), SHLAG_BTT_TBL4(f, (i)+4), \
+    SHLAG_BTT_TBL4(f, (i)+8), SHLAG_BTT_TBL4(f, (i)+12)
+#define SHLAG_BTT_TBL32(f, i) SHLAG_BTT_TBL16(f, i), SHLAG_BTT_TBL16(f, (i)+16)
+#define SHLAG_BTT_TBL64(f, i) SHLAG_BTT_TBL32(f, i), SHLAG_BTT_TBL32(f, (i)+32)
+#define SHLAG_BTT_TBL256(f, i) SHLAG_BTT_TBL64(f, i), SHLAG_BTT_TBL64(f, (i)+64), \
+    SHLAG_BTT_TBL64(f, (i)+128), SHLAG_BTT_TBL64(f, (i)+192)
+// 2d variant: f(row, col) for 64x64 table. Expressions passed to f stay short this way
+#define SHLAG_BTT_ROW4(f, r, i) f(r, i), f(r, (i)+1), f(r, (i)+2), f(r, (i)+3)
+#define SHLAG_BTT_ROW16(f, r, i) SHLAG_BTT_ROW4(f, r, i), SHLAG_BTT_ROW4(f, r, (i)+4), \
+    SHLAG_BTT_ROW4(f, r, (i)+8), SHLAG_BTT_ROW4(f, r, (i)+12)
+#define SHLAG_BTT_ROW64(f, r) SHLAG_BTT_ROW16(f, r, 0), SHLAG_BTT_ROW16(f, r, 16), \
+    SHLAG_BTT_ROW16(f, r, 32), SHLAG_BTT_ROW16(f, r, 48)
+#define SHLAG_BTT_IN(c, lo, hi) ((c) >= (lo) && (c) <= (hi))
 
-// encode normal block of 3 bytes (result is 4 bytes)
-static inline void shlag_b64enc_triple(const uint8_t* in, char* out)
+// base64 variants differ only in chars used for 62 and 63
+#define SHLAG_B64_CHR(v, c62, c63) ((v) < 26 ? 'A' + (v) : (v) < 52 ? 'a' + (v) - 26 : \
+    (v) < 62 ? '0' + (v) - 52 : (v) == 62 ? (c62) : (c63))
+#define SHLAG_B64_VAL(c, c62, c63) (SHLAG_BTT_IN(c, 'A', 'Z') ? (c) - 'A' : \
+    SHLAG_BTT_IN(c, 'a', 'z') ? (c) - 'a' + 26 : SHLAG_BTT_IN(c, '0', '9') ? (c) - '0' + 52 : \
+    (c) == (c62) ? 62 : (c) == (c63) ? 63 : (c) == '=' ? SHLAG_B64_PAD : SHLAG_B64_BAD)
+#define SHLAG_B64_STD_CHR(v) SHLAG_B64_CHR(v, '+', '/')
+#define SHLAG_B64_STD_VAL(c) SHLAG_B64_VAL(c, '+', '/')
+#define SHLAG_B64_URL_CHR(v) SHLAG_B64_CHR(v, '-', '_')
+#define SHLAG_B64_URL_VAL(c) SHLAG_B64_VAL(c, '-', '_')
+
+#define SHLAG_B32_CHR(v) ((v) < 26 ? 'A' + (v) : '2' + (v) - 26)
+#define SHLAG_B32_VAL(c) (SHLAG_BTT_IN(c, 'A', 'Z') ? (c) - 'A' : \
+    SHLAG_BTT_IN(c, '2', '7') ? (c) - '2' + 26 : (c) == '=' ? SHLAG_B64_PAD : SHLAG_B64_BAD)
+
+// @a is 'A' or 'a'. Base16 has no padding, so '=' is just invalid char
+#define SHLAG_B16_CHR(v, a) ((v) < 10 ? '0' + (v) : (a) + (v) - 10)
+#define SHLAG_B16_UPPER_CHR(v) SHLAG_B16_CHR(v, 'A')
+#define SHLAG_B16_LOWER_CHR(v) SHLAG_B16_CHR(v, 'a')
+#define SHLAG_B16_VAL(c) (SHLAG_BTT_IN(c, '0', '9') ? (c) - '0' : \
+    SHLAG_BTT_IN(c, 'A', 'F') ? (c) - 'A' + 10 : SHLAG_BTT_IN(c, 'a', 'f') ? (c) - 'a' + 10 : SHLAG_B64_BAD)
+
+// lookup tables for converting n-bit binary into character
+static const char shlag_b64chars[64] = { SHLAG_BTT_TBL64(SHLAG_B64_STD_CHR, 0) };
+static const char shlag_b64urlchars[64] = { SHLAG_BTT_TBL64(SHLAG_B64_URL_CHR, 0) };
+static const char shlag_b32chars[32] = { SHLAG_BTT_TBL32(SHLAG_B32_CHR, 0) };
+static const char shlag_b16chars[16] = { SHLAG_BTT_TBL16(SHLAG_B16_UPPER_CHR, 0) };
+static const char shlag_b16lowerchars[16] = { SHLAG_BTT_TBL16(SHLAG_B16_LOWER_CHR, 0) };
+
+// Lookup tables for converting character into n-bit binary
+// Invalid chars are represented as BAD (64). '=' padding is represented as PAD (128)
+static const uint8_t shlag_b64bits[256] = { SHLAG_BTT_TBL256(SHLAG_B64_STD_VAL, 0) };
+static const uint8_t shlag_b64urlbits[256] = { SHLAG_BTT_TBL256(SHLAG_B64_URL_VAL, 0) };
+static const uint8_t shlag_b32bits[256] = { SHLAG_BTT_TBL256(SHLAG_B32_VAL, 0) };
+static const uint8_t shlag_b16bits[256] = { SHLAG_BTT_TBL256(SHLAG_B16_VAL, 0) };
+
+// -- block engine --
+// Every encoding splits data into blocks of @bb bytes, represented as @bc chars carrying
+// @bpc bits each (base64: 3/4/6, base32: 5/8/5, base16: 1/2/4). Engine funcs get geometry
+// and tables as compile time constants from wrappers, so after inlining each alphabet
+// ends up with its own specialized kernel, without any branching on them at runtime.
+
+// count of chars needed for carrying @n bytes (without padding)
+#define SHLAG_BTT_NCHARS(n, bpc) (((n)*8 + (bpc) - 1) / (bpc))
+
+// Optional vectorized kernels, that process as much of data as they can.
+// Encoder gets region made of full blocks, encodes its tail (output of block k goes to
+// out + k*bc) and returns size of not yet encoded head. Decoder eats input from the start,
+// but never last char (scalar code has to validate last block) and stops on anything
+// it doesn't handle (padding, invalid chars). It returns count of consumed chars
+typedef int64_t (*shlag_btt_bulkenc)(const uint8_t* in, int64_t inSize, char* out);
+typedef int64_t (*shlag_btt_bulkdec)(const char* in, int64_t inLen, uint8_t* out);
+
+// encode normal block. Whole block is loaded before anything is stored, so it works inplace
+SHLAG_BTT_INLINE void shlag_btt_enc_block(const uint8_t* in, char* out, const char* chars,
+        int bpc, int bb, int bc)
 {
+    uint64_t acc = 0;
+    SHLAG_BTT_UNROLL
+    for(int k = 0; k < bb; ++k) acc = (acc << 8) | in[k];
     // yes, it is kinda hard to read as we encode from backwards (to make inplace enc possible)
-    out[3] = shlag_b64chars[in[2] & 0x3F]; // just 6LSB from 3rd byte
-    out[2] = shlag_b64chars[((in[1] & 0xF) << 2) | (in[2] >> 6)]; // 4LSB from 2nd, 2MSB from 3rd
-    out[1] = shlag_b64chars[((in[0] & 0x3) << 4) | (in[1] >> 4)]; // 2LSB from 1st, 4MSB from 2nd
-    out[0] = shlag_b64chars[in[0] >> 2]; // just 6MSB from 1st
+    SHLAG_BTT_UNROLL
+    for(int k = bc - 1; k >= 0; --k) {
+        out[k] = chars[acc & ((1u << bpc) - 1)];
+        acc >>= bpc;
+    }
 }
 
-// encode 1 or 2 byte "leftover" block that goes after packs of threes and pad it with `=` to 4 bytes
-static inline void shlag_b64enc_leftover(const uint8_t* in, char* out, uint8_t leftover)
+// encode "leftover" block (shorter than @bb) that goes after full blocks.
+// If @pad, it is padded with `=` to @bc chars
+SHLAG_BTT_INLINE void shlag_btt_enc_leftover(const uint8_t* in, char* out, int leftover,
+        const char* chars, int bpc, int bb, int bc, int pad)
 {
-    // yes, it is kinda hard to read as we encode from backwards (to make inplace enc possible)
-    if(leftover == 2) {
-        out[3] = '='; // padding
-        out[2] = shlag_b64chars[(in[1] & 0xF) << 2]; // 4 LSB from 2nd leftover byte
-        out[1] = shlag_b64chars[(in[0] & 0x3) << 4 | (in[1] >> 4)]; // 2LSB from 1st, then 4MSB from 2nd
-        out[0] = shlag_b64chars[in[0] >> 2]; // 6MSB from 1st byte
-    } else { /* leftover == 1 */
-        out[3] = '='; // padding
-        out[2] = '=';
-        out[1] = shlag_b64chars[(in[0] & 0x3) << 4]; // 2LSB from leftover byte
-        out[0] = shlag_b64chars[in[0] >> 2]; // 6MSB from leftover byte
-    }
+    uint8_t block[8] = {0}; // zero filled copy, so we don't care about inplace and OOB
+    char tmp[8];
+    memcpy(block, in, leftover);
+    shlag_btt_enc_block(block, tmp, chars, bpc, bb, bc);
+    const int nchars = SHLAG_BTT_NCHARS(leftover, bpc);
+    memcpy(out, tmp, nchars);
+    if(pad) memset(out + nchars, '=', bc - nchars);
 }
 
-void shlag_b64enc(const uint8_t* in, int64_t inSize, char* out)
+// @outLen is length of encoded text (without null terminator)
+SHLAG_BTT_INLINE void shlag_btt_enc(const uint8_t* in, int64_t inSize, char* out, int64_t outLen,
+        const char* chars, int bpc, int bb, int bc, int pad, shlag_btt_bulkenc bulk)
 {
     // we encode in backwards order to avoid overwriting not yet encoded data (to make inplace enc possible)
-    int64_t outLen = SHLAG_B64_ENCSIZE(inSize) - 1;
     out[outLen] = '\0';
-    const uint8_t leftover = inSize % 3; // how many bytes after packs of 3
+    const int leftover = inSize % bb; // how many bytes after full blocks
     if(leftover) {
-        outLen -= 4; inSize -= leftover;
-        shlag_b64enc_leftover(in + inSize, out + outLen, leftover);
+        outLen -= pad ? bc : SHLAG_BTT_NCHARS(leftover, bpc);
+        inSize -= leftover;
+        shlag_btt_enc_leftover(in + inSize, out + outLen, leftover, chars, bpc, bb, bc, pad);
+    }
+    if(bulk) {
+        inSize = bulk(in, inSize, out);
+        outLen = inSize / bb * bc;
     }
     while(inSize > 0) {
-        outLen -= 4;
-        inSize -= 3;
-        shlag_b64enc_triple(in + inSize, out + outLen);
+        outLen -= bc;
+        inSize -= bb;
+        shlag_btt_enc_block(in + inSize, out + outLen, chars, bpc, bb, bc);
     }
 }
 
-#define SHLAG_B64_MAX_VALID 63 // 0b00111111
-#define SHLAG_B64_BAD 64    // 0b01000000
-#define SHLAG_B64_PAD 128   // 0b10000000
-// BAD and PAD are bitflags used for input validation
-
-// Lookup table for converting base64 character into 6-bit binary
-// Invalid chars are inited with 64. '=' padding is represented as 128
-// generated with script: https://gist.github.com/gizlu/14c5d930241244b8045f3043f8883d93
-static const uint8_t shlag_b64bits[256] = {64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,62,64,64,64,63,52,53,54,55,56,57,58,59,60,61,64,64,64,128,64,64,64,0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15,16,17,18,19,20,21,22,23,24,25,64,64,64,64,64,64,26,27,28,29,30,31,32,33,34,35,36,37,38,39,40,41,42,43,44,45,46,47,48,49,50,51,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64,64};
-
-// decode normal block of 4 bytes (result is 3 bytes)
-// Returns "status" - byte that you can check for BAD_CH and PAD_CH bitflags
-static inline uint8_t shlag_b64dec_four(const uint8_t* in, uint8_t* out)
+// decode normal block. Returns "status" - byte that you can check for BAD and PAD bitflags
+SHLAG_BTT_INLINE uint8_t shlag_btt_dec_block(const uint8_t* in, uint8_t* out, const uint8_t* bits,
+        int bpc, int bb, int bc)
 {
-    // compiler seem to output less retarded asm with these tmp vars
-    uint8_t a = shlag_b64bits[in[0]], b = shlag_b64bits[in[1]], c = shlag_b64bits[in[2]], d = shlag_b64bits[in[3]];
-    out[0] = (a << 2) | (b >> 4);
-    out[1] = (b << 4) | (c >> 2);
-    out[2] = (c << 6) | (d);
-    return a | b | c | d;
+    uint64_t acc = 0;
+    uint8_t status = 0;
+    SHLAG_BTT_UNROLL
+    for(int k = 0; k < bc; ++k) {
+        const uint8_t v = bits[in[k]];
+        status |= v;
+        acc |= (uint64_t)v << (bpc * (bc - 1 - k)); // garbage on BAD/PAD, but status catches it
+    }
+    SHLAG_BTT_UNROLL
+    for(int k = bb - 1; k >= 0; --k) {
+        out[k] = (uint8_t)acc;
+        acc >>= 8;
+    }
+    return status;
 }
 
-// decode last block of specified size (2,3 or 4). It doesn't return status
-static inline void shlag_b64dec_last(const uint8_t* in, uint8_t* out, uint8_t blocksize)
+// decode last block of @blocksize chars (already validated) into @nbytes
+SHLAG_BTT_INLINE void shlag_btt_dec_last(const uint8_t* in, uint8_t* out, int blocksize, int nbytes,
+        const uint8_t* bits, int bpc, int bb, int bc)
 {
-    // if(blocksize >= 2) {  // always true
-        out[0] = (shlag_b64bits[in[0]] << 2) | (shlag_b64bits[in[1]] >> 4);
-    // }
-    if(blocksize >= 3) {
-        out[1] = (shlag_b64bits[in[1]] << 4) | (shlag_b64bits[in[2]] >> 2);
+    uint64_t acc = 0;
+    for(int k = 0; k < blocksize; ++k) {
+        acc |= (uint64_t)bits[in[k]] << (bpc * (bc - 1 - k));
     }
-    if(blocksize == 4) {
-        out[2] = (shlag_b64bits[in[2]] << 6) | (shlag_b64bits[in[3]]);
+    for(int k = 0; k < nbytes; ++k) {
+        out[k] = (uint8_t)(acc >> (8 * (bb - 1 - k)));
     }
 }
-int64_t shlag_b64dec(const char* in, int64_t inLen, uint8_t* out)
+
+SHLAG_BTT_INLINE int64_t shlag_btt_dec(const char* in, int64_t inLen, uint8_t* out,
+        const uint8_t* bits, int bpc, int bb, int bc, shlag_btt_bulkdec bulk)
 {
     if(inLen == 0) return 0;
     uint8_t status = 0;
     int64_t i = 0, j = 0;
 
-    while(i + 4 < inLen) {
-        status |= shlag_b64dec_four((uint8_t*)in + i, out + j);
-        i += 4; j += 3;
+    if(bulk) {
+        i = bulk(in, inLen, out);
+        j = i / bc * bb;
+    }
+    while(i + bc < inLen) {
+        status |= shlag_btt_dec_block((const uint8_t*)in + i, out + j, bits, bpc, bb, bc);
+        i += bc; j += bb;
     }
     if(status & SHLAG_B64_PAD) return -1; // padding can't occur outside last block
 
     // last block is decoded differently (cause its size varies, and it may use padding)
-    int64_t blocksize = 0;
+    int blocksize = 0;
     for(; i+blocksize < inLen; ++blocksize) {
-        status |= shlag_b64bits[(uint8_t)in[i+blocksize]];
+        status |= bits[(uint8_t)in[i+blocksize]];
         if(status & SHLAG_B64_PAD) break;
     }
     if(status & SHLAG_B64_BAD) return -1;
-    if(blocksize == 1) return -1; // one byte leftover is impossible in valid b64
+    // e.g. one char leftover is impossible in valid b64. It also rejects block made of padding only
+    const int nbytes = blocksize * bpc / 8;
+    if(nbytes == 0 || SHLAG_BTT_NCHARS(nbytes, bpc) != blocksize) return -1;
     for(int64_t k = i + blocksize + 1; k < inLen; ++k) {
         if(in[k] != '=') return -1; /* only padding is legal after last block */
     }
 
-    shlag_b64dec_last((uint8_t*)in + i, out + j, blocksize);
-    return j + blocksize - 1;
+    shlag_btt_dec_last((const uint8_t*)in + i, out + j, blocksize, nbytes, bits, bpc, bb, bc);
+    return j + nbytes;
+}
+
+// -- vectorized kernels --
+
+#if defined(__SSSE3__)
+// base64 encoding with multiply trick by Wojciech Muła: http://0x80.pl/notesen/2016-01-12-sse-base64-encoding.html
+// 12 bytes -> 16 chars per step. We load 16 bytes *ending* at end of step (4 bytes before it
+// are ignored), so we never read past input and don't need spare space in separate @in buffer
+SHLAG_BTT_INLINE int64_t shlag_b64enc_ssse3(const uint8_t* in, int64_t inSize, char* out, char c62, char c63)
+{
+    const __m128i shuf = _mm_setr_epi8(5,4,6,5, 8,7,9,8, 11,10,12,11, 14,13,15,14);
+    const __m128i offsets = _mm_setr_epi8('a'-26, '0'-52, '0'-52, '0'-52, '0'-52, '0'-52, '0'-52,
+            '0'-52, '0'-52, '0'-52, '0'-52, c62-62, c63-63, 'A', 0, 0);
+    while(inSize >= 16) {
+        __m128i v = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(in + inSize - 16)), shuf);
+        // move each 6 bit field into separate byte
+        const __m128i t0 = _mm_mulhi_epu16(_mm_and_si128(v, _mm_set1_epi32(0x0fc0fc00)), _mm_set1_epi32(0x04000040));
+        const __m128i t1 = _mm_mullo_epi16(_mm_and_si128(v, _mm_set1_epi32(0x003f03f0)), _mm_set1_epi32(0x01000010));
+        const __m128i idx = _mm_or_si128(t0, t1);
+        // map each value range (A-Z, a-z, 0-9, 62, 63) to slot in @offsets, and add that offset
+        __m128i slot = _mm_subs_epu8(idx, _mm_set1_epi8(51));
+        slot = _mm_or_si128(slot, _mm_and_si128(_mm_cmpgt_epi8(_mm_set1_epi8(26), idx), _mm_set1_epi8(13)));
+        inSize -= 12;
+        _mm_storeu_si128((__m128i*)(out + inSize / 3 * 4), _mm_add_epi8(_mm_shuffle_epi8(offsets, slot), idx));
+    }
+    return inSize;
+}
+
+// base64 decoding. Translation is done with range compares rather than nibble lookups, as
+// it lets us support any c62/c63 pair. Packing is Muła's: http://0x80.pl/notesen/2016-01-17-sse-base64-decoding.html
+SHLAG_BTT_INLINE int64_t shlag_b64dec_ssse3(const char* in, int64_t inLen, uint8_t* out, char c62, char c63)
+{
+    int64_t i = 0;
+    while(i + 16 < inLen) {
+        const __m128i v = _mm_loadu_si128((const __m128i*)(in + i));
+        // chars >= 0x80 are negative, so they fail all range checks
+        const __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('A'-1)), _mm_cmplt_epi8(v, _mm_set1_epi8('Z'+1)));
+        const __m128i lower = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('a'-1)), _mm_cmplt_epi8(v, _mm_set1_epi8('z'+1)));
+        const __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('0'-1)), _mm_cmplt_epi8(v, _mm_set1_epi8('9'+1)));
+        const __m128i is62 = _mm_cmpeq_epi8(v, _mm_set1_epi8(c62));
+        const __m128i is63 = _mm_cmpeq_epi8(v, _mm_set1_epi8(c63));
+        const __m128i valid = _mm_or_si128(_mm_or_si128(upper, lower), _mm_or_si128(digit, _mm_or_si128(is62, is63)));
+        if(_mm_movemask_epi8(valid) != 0xFFFF) break; // let scalar code deal with it
+
+        __m128i shift = _mm_and_si128(upper, _mm_set1_epi8(-'A'));
+        shift = _mm_or_si128(shift, _mm_and_si128(lower, _mm_set1_epi8(26-'a')));
+        shift = _mm_or_si128(shift, _mm_and_si128(digit, _mm_set1_epi8(52-'0')));
+        shift = _mm_or_si128(shift, _mm_and_si128(is62, _mm_set1_epi8(62-c62)));
+        shift = _mm_or_si128(shift, _mm_and_si128(is63, _mm_set1_epi8(63-c63)));
+        __m128i bits = _mm_add_epi8(v, shift);
+        // pack 16 6-bit values into 12 bytes
+        bits = _mm_maddubs_epi16(bits, _mm_set1_epi32(0x01400140));
+        bits = _mm_madd_epi16(bits, _mm_set1_epi32(0x00011000));
+        bits = _mm_shuffle_epi8(bits, _mm_setr_epi8(2,1,0, 6,5,4, 10,9,8, 14,13,12, -1,-1,-1,-1));
+        // store exactly 12 bytes, so separate @out doesn't need spare space
+        uint8_t* o = out + i / 4 * 3;
+        const int32_t tail = _mm_cvtsi128_si32(_mm_srli_si128(bits, 8));
+        _mm_storel_epi64((__m128i*)o, bits);
+        memcpy(o + 8, &tail, 4);
+        i += 16;
+    }
+    return i;
+}
+
+static int64_t shlag_b64enc_bulk(const uint8_t* in, int64_t inSize, char* out)
+{ return shlag_b64enc_ssse3(in, inSize, out, '+', '/'); }
+static int64_t shlag_b64urlenc_bulk(const uint8_t* in, int64_t inSize, char* out)
+{ return shlag_b64enc_ssse3(in, inSize, out, '-', '_'); }
+static int64_t shlag_b64dec_bulk(const char* in, int64_t inLen, uint8_t* out)
+{ return shlag_b64dec_ssse3(in, inLen, out, '+', '/'); }
+static int64_t shlag_b64urldec_bulk(const char* in, int64_t inLen, uint8_t* out)
+{ return shlag_b64dec_ssse3(in, inLen, out, '-', '_'); }
+#elif defined(SHLAG_B64_WIDE)
+// Wide scalar kernels. Words are assembled in little endian order (first byte in LSB), so
+// on LE machines they are loaded/stored with single memcpy, and byte by byte elsewhere
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+ #define SHLAG_B64_LE 1
+#else
+ #define SHLAG_B64_LE 0
+#endif
+
+// 2 chars for 12 bit value (hi6 << 6 | lo6), packed as they lay in memory
+#define SHLAG_B64_STD_PAIR(hi, lo) (SHLAG_B64_STD_CHR(hi) | SHLAG_B64_STD_CHR(lo) << 8)
+#define SHLAG_B64_URL_PAIR(hi, lo) (SHLAG_B64_URL_CHR(hi) | SHLAG_B64_URL_CHR(lo) << 8)
+#define SHLAG_B64_STD_PAIRS(hi) SHLAG_BTT_ROW64(SHLAG_B64_STD_PAIR, hi)
+#define SHLAG_B64_URL_PAIRS(hi) SHLAG_BTT_ROW64(SHLAG_B64_URL_PAIR, hi)
+static const uint16_t shlag_b64pairs[4096] = { SHLAG_BTT_TBL64(SHLAG_B64_STD_PAIRS, 0) };
+static const uint16_t shlag_b64urlpairs[4096] = { SHLAG_BTT_TBL64(SHLAG_B64_URL_PAIRS, 0) };
+
+// Value of @pos-th char of block, already shifted to its place in 3 output bytes (little
+// endian word). BAD/PAD flags go into 4th byte, so OR of 4 lookups is also block status
+#define SHLAG_B64_WIDE_ENTRY(v, pos) ((uint32_t)((v) > SHLAG_B64_MAX_VALID ? (uint32_t)(v) << 24 : \
+    (pos) == 0 ? (v) << 2 : (pos) == 1 ? ((v) >> 4) | ((v) & 0xF) << 12 : \
+    (pos) == 2 ? ((v) >> 2) << 8 | ((v) & 0x3) << 22 : (v) << 16))
+#define SHLAG_B64_STD_D0(c) SHLAG_B64_WIDE_ENTRY(SHLAG_B64_STD_VAL(c), 0)
+#define SHLAG_B64_STD_D1(c) SHLAG_B64_WIDE_ENTRY(SHLAG_B64_STD_VAL(c), 1)
+#define SHLAG_B64_STD_D2(c) SHLAG_B64_WIDE_ENTRY(SHLAG_B64_STD_VAL(c), 2)
+#define SHLAG_B64_STD_D3(c) SHLAG_B64_WIDE_ENTRY(SHLAG_B64_STD_VAL(c), 3)
+#define SHLAG_B64_URL_D0(c) SHLAG_B64_WIDE_ENTRY(SHLAG_B64_URL_VAL(c), 0)
+#define SHLAG_B64_URL_D1(c) SHLAG_B64_WIDE_ENTRY(SHLAG_B64_URL_VAL(c), 1)
+#define SHLAG_B64_URL_D2(c) SHLAG_B64_WIDE_ENTRY(SHLAG_B64_URL_VAL(c), 2)
+#define SHLAG_B64_URL_D3(c) SHLAG_B64_WIDE_ENTRY(SHLAG_B64_URL_VAL(c), 3)
+static const uint32_t shlag_b64wide[4][256] = {
+    { SHLAG_BTT_TBL256(SHLAG_B64_STD_D0, 0) }, { SHLAG_BTT_TBL256(SHLAG_B64_STD_D1, 0) },
+    { SHLAG_BTT_TBL256(SHLAG_B64_STD_D2, 0) }, { SHLAG_BTT_TBL256(SHLAG_B64_STD_D3, 0) }};
+static const uint32_t shlag_b64urlwide[4][256] = {
+    { SHLAG_BTT_TBL256(SHLAG_B64_URL_D0, 0) }, { SHLAG_BTT_TBL256(SHLAG_B64_URL_D1, 0) },
+    { SHLAG_BTT_TBL256(SHLAG_B64_URL_D2, 0) }, { SHLAG_BTT_TBL256(SHLAG_B64_URL_D3, 0) }};
+
+SHLAG_BTT_INLINE void shlag_b64_store32(void* out, uint32_t w)
+{
+    if(SHLAG_B64_LE) { memcpy(out, &w, 4); return; }
+    uint8_t* o = (uint8_t*)out;
+    o[0] = (uint8_t)w; o[1] = (uint8_t)(w >> 8); o[2] = (uint8_t)(w >> 16); o[3] = (uint8_t)(w >> 24);
+}
+
+// Encodes all blocks. Block is still read byte by byte - reading whole word could go past
+// separate @in buffer
+SHLAG_BTT_INLINE int64_t shlag_b64enc_wide(const uint8_t* in, int64_t inSize, char* out, const uint16_t* pairs)
+{
+    int64_t outLen = inSize / 3 * 4;
+    while(inSize > 0) {
+        inSize -= 3; outLen -= 4;
+        const uint32_t x = (uint32_t)in[inSize] << 16 | (uint32_t)in[inSize+1] << 8 | in[inSize+2];
+        shlag_b64_store32(out + outLen, pairs[x >> 12] | (uint32_t)pairs[x & 0xFFF] << 16);
+    }
+    return 0;
+}
+
+// Decodes blocks until the one before last, or until BAD/PAD char. 4th byte written by
+// each word store is overwritten by next block. We stop while at least 2 chars are left,
+// so that next block always yields at least one byte and the store stays within @out.
+// When decoding inplace, it never reaches unread input
+SHLAG_BTT_INLINE int64_t shlag_b64dec_wide(const char* in, int64_t inLen, uint8_t* out, const uint32_t (*wide)[256])
+{
+    int64_t i = 0, j = 0;
+    while(i + 5 < inLen) {
+        uint32_t x;
+        if(SHLAG_B64_LE) memcpy(&x, in + i, 4);
+        else x = (uint8_t)in[i] | (uint8_t)in[i+1] << 8 | (uint8_t)in[i+2] << 16 | (uint32_t)(uint8_t)in[i+3] << 24;
+        const uint32_t w = wide[0][x & 0xFF] | wide[1][(x >> 8) & 0xFF] | wide[2][(x >> 16) & 0xFF] | wide[3][x >> 24];
+        if(w >> 24) break; // let scalar code deal with it
+        shlag_b64_store32(out + j, w);
+        i += 4; j += 3;
+    }
+    return i;
+}
+
+static int64_t shlag_b64enc_bulk(const uint8_t* in, int64_t inSize, char* out)
+{ return shlag_b64enc_wide(in, inSize, out, shlag_b64pairs); }
+static int64_t shlag_b64urlenc_bulk(const uint8_t* in, int64_t inSize, char* out)
+{ return shlag_b64enc_wide(in, inSize, out, shlag_b64urlpairs); }
+static int64_t shlag_b64dec_bulk(const char* in, int64_t inLen, uint8_t* out)
+{ return shlag_b64dec_wide(in, inLen, out, shlag_b64wide); }
+static int64_t shlag_b64urldec_bulk(const char* in, int64_t inLen, uint8_t* out)
+{ return shlag_b64dec_wide(in, inLen, out, shlag_b64urlwide); }
+#else
+ #define shlag_b64enc_bulk 0
+ #define shlag_b64urlenc_bulk 0
+ #define shlag_b64dec_bulk 0
+ #define shlag_b64urldec_bulk 0
+#endif // __SSSE3__, SHLAG_B64_WIDE
+
+#if defined(__SSE2__)
+// map nibbles to hex digits. @a is 'A' or 'a'
+SHLAG_BTT_INLINE __m128i shlag_b16chars_sse2(__m128i v, char a)
+{
+    const __m128i letter = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8(9)), _mm_set1_epi8(a - '0' - 10));
+    return _mm_add_epi8(_mm_add_epi8(v, _mm_set1_epi8('0')), letter);
+}
+
+// 16 bytes -> 32 chars per step, from backwards (it works inplace as 2*inSize >= inSize)
+SHLAG_BTT_INLINE int64_t shlag_b16enc_sse2(const uint8_t* in, int64_t inSize, char* out, char a)
+{
+    const __m128i lo4 = _mm_set1_epi8(0x0F);
+    while(inSize >= 16) {
+        inSize -= 16;
+        const __m128i v = _mm_loadu_si128((const __m128i*)(in + inSize));
+        const __m128i hi = shlag_b16chars_sse2(_mm_and_si128(_mm_srli_epi16(v, 4), lo4), a);
+        const __m128i lo = shlag_b16chars_sse2(_mm_and_si128(v, lo4), a);
+        _mm_storeu_si128((__m128i*)(out + 2*inSize + 16), _mm_unpackhi_epi8(hi, lo));
+        _mm_storeu_si128((__m128i*)(out + 2*inSize), _mm_unpacklo_epi8(hi, lo));
+    }
+    return inSize;
+}
+
+// map hex digits (any case) to nibbles. Sets @valid to movemask of valid lanes
+SHLAG_BTT_INLINE __m128i shlag_b16bits_sse2(__m128i v, int* valid)
+{
+    const __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('0'-1)), _mm_cmplt_epi8(v, _mm_set1_epi8('9'+1)));
+    const __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('A'-1)), _mm_cmplt_epi8(v, _mm_set1_epi8('F'+1)));
+    const __m128i lower = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('a'-1)), _mm_cmplt_epi8(v, _mm_set1_epi8('f'+1)));
+    *valid = _mm_movemask_epi8(_mm_or_si128(digit, _mm_or_si128(upper, lower)));
+    __m128i shift = _mm_and_si128(digit, _mm_set1_epi8(-'0'));
+    shift = _mm_or_si128(shift, _mm_and_si128(upper, _mm_set1_epi8(10-'A')));
+    shift = _mm_or_si128(shift, _mm_and_si128(lower, _mm_set1_epi8(10-'a')));
+    return _mm_add_epi8(v, shift);
+}
+
+// 32 chars -> 16 bytes per step
+static int64_t shlag_b16dec_bulk(const char* in, int64_t inLen, uint8_t* out)
+{
+    int64_t i = 0;
+    while(i + 32 < inLen) {
+        int valid0, valid1;
+        const __m128i v0 = shlag_b16bits_sse2(_mm_loadu_si128((const __m128i*)(in + i)), &valid0);
+        const __m128i v1 = shlag_b16bits_sse2(_mm_loadu_si128((const __m128i*)(in + i + 16)), &valid1);
+        if((valid0 & valid1) != 0xFFFF) break; // let scalar code deal with it
+        // each 16bit lane holds (lo nibble << 8 | hi nibble)
+        const __m128i lo8 = _mm_set1_epi16(0x00FF);
+        const __m128i b0 = _mm_and_si128(_mm_or_si128(_mm_slli_epi16(v0, 4), _mm_srli_epi16(v0, 8)), lo8);
+        const __m128i b1 = _mm_and_si128(_mm_or_si128(_mm_slli_epi16(v1, 4), _mm_srli_epi16(v1, 8)), lo8);
+        _mm_storeu_si128((__m128i*)(out + i / 2), _mm_packus_epi16(b0, b1));
+        i += 32;
+    }
+    return i;
+}
+static int64_t shlag_b16enc_bulk(const uint8_t* in, int64_t inSize, char* out)
+{ return shlag_b16enc_sse2(in, inSize, out, 'A'); }
+static int64_t shlag_b16enc_lower_bulk(const uint8_t* in, int64_t inSize, char* out)
+{ return shlag_b16enc_sse2(in, inSize, out, 'a'); }
+#else
+ #define shlag_b16enc_bulk 0
+ #define shlag_b16enc_lower_bulk 0
+ #define shlag_b16dec_bulk 0
+#endif // __SSE2__
+
+// base32 has no vector kernel - its 5 byte blocks don't map nicely onto vector lanes,
+// and 40 bit block fits in one register anyway
+
+// -- public wrappers --
+
+void shlag_b64enc(const uint8_t* in, int64_t inSize, char* out)
+{
+    shlag_btt_enc(in, inSize, out, SHLAG_B64_ENCSIZE(inSize) - 1, shlag_b64chars, 6, 3, 4, 1, shlag_b64enc_bulk);
+}
+int64_t shlag_b64dec(const char* in, int64_t inLen, uint8_t* out)
+{
+    return shlag_btt_dec(in, inLen, out, shlag_b64bits, 6, 3, 4, shlag_b64dec_bulk);
+}
+
+void shlag_b64urlenc(const uint8_t* in, int64_t inSize, char* out)
+{
+    shlag_btt_enc(in, inSize, out, SHLAG_B64URL_ENCSIZE(inSize) - 1, shlag_b64urlchars, 6, 3, 4, 0, shlag_b64urlenc_bulk);
+}
+int64_t shlag_b64urldec(const char* in, int64_t inLen, uint8_t* out)
+{
+    return shlag_btt_dec(in, inLen, out, shlag_b64urlbits, 6, 3, 4, shlag_b64urldec_bulk);
+}
+
+void shlag_b32enc(const uint8_t* in, int64_t inSize, char* out)
+{
+    shlag_btt_enc(in, inSize, out, SHLAG_B32_ENCSIZE(inSize) - 1, shlag_b32chars, 5, 5, 8, 1, 0);
+}
+int64_t shlag_b32dec(const char* in, int64_t inLen, uint8_t* out)
+{
+    return shlag_btt_dec(in, inLen, out, shlag_b32bits, 5, 5, 8, 0);
+}
+
+void shlag_b16enc(const uint8_t* in, int64_t inSize, char* out)
+{
+    shlag_btt_enc(in, inSize, out, SHLAG_B16_ENCSIZE(inSize) - 1, shlag_b16chars, 4, 1, 2, 0, shlag_b16enc_bulk);
+}
+void shlag_b16enc_lower(const uint8_t* in, int64_t inSize, char* out)
+{
+    shlag_btt_enc(in, inSize, out, SHLAG_B16_ENCSIZE(inSize) - 1, shlag_b16lowerchars, 4, 1, 2, 0, shlag_b16enc_lower_bulk);
+}
+int64_t shlag_b16dec(const char* in, int64_t inLen, uint8_t* out)
+{
+    return shlag_btt_dec(in, inLen, out, shlag_b16bits, 4, 1, 2, shlag_b16dec_bulk);
 }
 #endif // SHLAG_B64_IMPL
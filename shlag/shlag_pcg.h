@@ -1,16 +1,24 @@
 /* 32bit PCG psuedorandom number generator + fast algorithm for adjusting
- * generated numbers to specified range, wrapped as single file lib
+ * generated numbers to specified range, wrapped as single file lib. There is also
+ * 64bit variant (shlag_pcg64, 128bit state) for when 32 bits per call is not enough
  *
  * Do this: #define SHLAG_PCG_IMPL
  * before you include this file in *one* C or C++ file to create the implementation.
  * You can also optionally enable assertions by defining SHLAG_PCG_DEBUG
- * Other compile time options: SHLAG_PCG_DEF, SHLAG_PCG_ASSERT, SHLAG_PCG_EXAMPLE
+ * Other compile time options: SHLAG_PCG_DEF, SHLAG_PCG_ASSERT, SHLAG_PCG_EXAMPLE,
+ * SHLAG_PCG_NORMAL (enables normal distribution sampler, you have to link libm then)
  *
  * Credits:
  * - PCG (Melissa O'Neill, MIT or Apache 2.0 licenses): https://github.com/imneme/pcg-c
  * - fast method for adjusting numbers to specified bound without bias (Daniel Lemire,
  *   Public Domain): https://lemire.me/blog/2016/06/30/fast-random-shuffling/
  *   Link includes benchmark and comparison with other methods such as modulo
+ * - ziggurat method for normal distribution (George Marsaglia, Wai Wan Tsang, with
+ *   improvements from Jurgen A. Doornik): https://www.doornik.com/research/ziggurat.pdf
+ * - batched version of Lemire's method, used by shuffle and sampling (Nevin Brackett-Rozinsky,
+ *   Daniel Lemire): "Batched Ranged Random Integer Generation", https://arxiv.org/abs/2408.06213.
+ *   It draws 2-6 indices per 64bit number, so below 2^30 elements pcg64 shuffle needs 1/2-1/6
+ *   call per element, and pcg32 one twice that (64bit number is two pcg32 calls)
  *
  * I just combined someone else's work into convenient form and wrote some docs.
  * Changes that I introduced, are very trivial. You could consider them to
@@ -18,13 +26,11 @@
  * While I tried to make it unbiased I warrant nothing
  *
  * Example: `examples/pcg_simple.c`
- *
- * TODO (MAYBE): float number generation, advancing prng by n steps without generating
- * numbers (it may be useful in multithreaded programs)
  */
 
 #ifndef SHLAG_PCG_H
 #define SHLAG_PCG_H
+#include <stddef.h>
 #include <stdint.h>
 
 // Prepend public function definitions with whatever you want. You can use it
@@ -59,6 +65,137 @@ SHLAG_PCG_DEF uint32_t shlag_pcg32_randrange0(shlag_pcg32* rng, uint32_t end);
 // gen random u32 in range <@begin, @end). If @begin==@end, return that number
 SHLAG_PCG_DEF uint32_t shlag_pcg32_randrange(shlag_pcg32* rng, uint32_t begin, uint32_t end);
 
+// Fill @buf with @n random u32. Same as calling rand() @n times, just faster
+SHLAG_PCG_DEF void shlag_pcg32_fill(shlag_pcg32* rng, uint32_t* buf, size_t n);
+// Fill @buf with @n random u32 in range <@begin, @end). Same as calling randrange() @n
+// times, but rejection threshold is computed just once
+SHLAG_PCG_DEF void shlag_pcg32_fillrange(shlag_pcg32* rng, uint32_t* buf, size_t n, uint32_t begin, uint32_t end);
+
+// Sampler for repeated draws from fixed range <begin, end). It caches rejection
+// threshold (and its division), so each draw is just mul and compare
+// Draws give same numbers as randrange(rng, begin, end) would
+typedef struct shlag_pcg32_bounded{
+    uint32_t begin;
+    uint32_t range;
+    uint32_t threshold;
+} shlag_pcg32_bounded;
+// Create sampler for range <@begin, @end). If @begin==@end, it always returns that number
+SHLAG_PCG_DEF shlag_pcg32_bounded shlag_pcg32_bounded_init(uint32_t begin, uint32_t end);
+// gen random u32 in sampler's range
+SHLAG_PCG_DEF uint32_t shlag_pcg32_bounded_rand(shlag_pcg32* rng, const shlag_pcg32_bounded* bounded);
+
+// Shuffle array of @n elements, each @size bytes long (Fisher-Yates). When ranges are
+// small enough, it draws 2-6 indices from single 64bit random number (batched Lemire's
+// method). 64bit number costs two rand() calls, so it needs one call per element above
+// 2^19 elements (like naive loop), 2/3 above 2^14, and 1/2-1/3 below. shlag_pcg64_shuffle()
+// needs half of that (e.g. 1/2 call per element for 10^8 elements)
+SHLAG_PCG_DEF void shlag_pcg32_shuffle(shlag_pcg32* rng, void* arr, size_t n, size_t size);
+// Sample @k of @n elements without replacement: move them to beginning of @arr in random
+// order (rest of @arr is left in some order). It's partial shuffle, so it takes O(@k)
+// time. If @k >= @n, it is just shuffle
+SHLAG_PCG_DEF void shlag_pcg32_sample(shlag_pcg32* rng, void* arr, size_t n, size_t size, size_t k);
+
+// Reservoir sampling: pick k random items from stream of unknown length. Init it with
+// {0, k}, then for each item call reservoir_add(): it tells you where to store item
+typedef struct shlag_pcg32_reservoir{
+    uint64_t seen; // number of items seen so far
+    uint64_t k; // reservoir size
+} shlag_pcg32_reservoir;
+// Returns reservoir slot <0, k) for next item, or -1 if item should be skipped
+SHLAG_PCG_DEF int64_t shlag_pcg32_reservoir_add(shlag_pcg32* rng, shlag_pcg32_reservoir* res);
+
+// gen random float in range <0, 1). It takes one rand() call and uses top 24 bits of it
+// as significand, so all results are multiples of 2^-24 (no division, no branches)
+SHLAG_PCG_DEF float shlag_pcg32_randf(shlag_pcg32* rng);
+// gen random double in range <0, 1), from 53 bits of two rand() calls (multiples of 2^-53)
+SHLAG_PCG_DEF double shlag_pcg32_randd(shlag_pcg32* rng);
+// gen random float/double in range <@begin, @end). Beware that due to rounding, result
+// may be equal to @end, when range is much wider than begin and end themselves
+SHLAG_PCG_DEF float shlag_pcg32_randf_range(shlag_pcg32* rng, float begin, float end);
+SHLAG_PCG_DEF double shlag_pcg32_randd_range(shlag_pcg32* rng, double begin, double end);
+// Fill @buf with @n floats/doubles. Same as calling randf()/randd() @n times, but
+// conversion to floating point is vectorized
+SHLAG_PCG_DEF void shlag_pcg32_fillf(shlag_pcg32* rng, float* buf, size_t n);
+SHLAG_PCG_DEF void shlag_pcg32_filld(shlag_pcg32* rng, double* buf, size_t n);
+
+#ifdef SHLAG_PCG_NORMAL
+// Tables for ziggurat normal sampler. Init them once with shlag_pcg_ziggurat_init(),
+// after that they are read only, so they can be shared between threads
+typedef struct shlag_pcg_ziggurat{
+    double x[129]; // right edges of layers
+    double r[128]; // x[i+1]/x[i], for quick "is it inside rectangle" test
+} shlag_pcg_ziggurat;
+SHLAG_PCG_DEF void shlag_pcg_ziggurat_init(shlag_pcg_ziggurat* zig);
+// gen random double from standard normal distribution (mean 0, stddev 1). Takes two
+// rand() calls in ~99% of cases. For other distributions, just do mean + stddev*normal
+SHLAG_PCG_DEF double shlag_pcg32_normal(shlag_pcg32* rng, const shlag_pcg_ziggurat* zig);
+#endif
+
+// Advance rng by @delta steps in O(log(delta)) time, as if you called rand() @delta times.
+// Period is 2^64, so you can go backwards by passing -steps (i.e 2^64 - steps)
+SHLAG_PCG_DEF void shlag_pcg32_advance(shlag_pcg32* rng, uint64_t delta);
+
+// Each substream is 2^48 numbers long, so you can have 2^16 of them in single stream
+#define SHLAG_PCG32_SUBSTREAM_LEN ((uint64_t)1 << 48)
+// Derive @n non-overlapping generators from @rng (e.g. one per worker thread or per work
+// item): @subs[i] is @rng advanced by (@first+i)*SHLAG_PCG32_SUBSTREAM_LEN steps. @rng is
+// left untouched. Substream depends just on its index, so if you split work into items
+// (instead of splitting it by thread count), results don't depend on number of threads.
+// Substreams don't overlap as long as each of them generates < 2^48 numbers and
+// @first+@n <= 2^16
+SHLAG_PCG_DEF void shlag_pcg32_split(const shlag_pcg32* rng, shlag_pcg32* subs, uint32_t first, uint32_t n);
+
+// 8 independent pcg32 generators advanced together. Single rand() call is serial
+// chain of 64bit muls, so cpu can't overlap consecutive calls. Here they are
+// independent, so they can be done in parallel. AVX2 is used if compiler is allowed to
+// emit it (e.g -mavx2 or -march=native), it is ~1.7x faster than scalar rand() then.
+// Otherwise it is plain loop that is about as fast as scalar version
+// Each lane works exactly like shlag_pcg32 with same state, so results can be checked
+// against scalar version. Internals (other than struct size) are private
+typedef struct shlag_pcg32x8{
+    uint64_t state[8];
+    uint64_t inc[8];
+} shlag_pcg32x8;
+
+// Seed lane i like shlag_pcg32_srand(@initstate[i], @initseq[i]) would
+SHLAG_PCG_DEF void shlag_pcg32x8_srand(shlag_pcg32x8* rng, const uint64_t initstate[8], const uint64_t initseq[8]);
+// Make lanes from 8 scalar generators (e.g ones created by shlag_pcg32_split())
+SHLAG_PCG_DEF void shlag_pcg32x8_pack(shlag_pcg32x8* rng, const shlag_pcg32 lanes[8]);
+// Get scalar generator in state of lane @i (0-7)
+SHLAG_PCG_DEF shlag_pcg32 shlag_pcg32x8_lane(const shlag_pcg32x8* rng, unsigned i);
+// gen random u32 in each lane. @out[i] comes from lane i
+SHLAG_PCG_DEF void shlag_pcg32x8_rand(shlag_pcg32x8* rng, uint32_t out[8]);
+
+// 64bit output pcg (pcg64, XSL RR variant with 128bit state). Use it when you need
+// 64bit numbers or ranges: one call costs about as much as one shlag_pcg32_rand() call
+// (on 64bit cpus with 64x64->128 mul), while stitching 2 pcg32 calls costs twice that.
+// 128bit math uses __uint128_t if compiler has it, portable code otherwise (same results).
+// Internals (other than struct size) are private
+typedef struct shlag_pcg64{
+    uint64_t state[2]; // 128bit state, {hi, lo}
+    uint64_t inc[2]; // 128bit stream selector, {hi, lo}. Always odd
+} shlag_pcg64;
+
+// Seed the rng. Same as pcg64_srandom_r() from pcg-c, with 128bit @initstate and
+// @initseq which have high 64 bits equal to 0. There are 2^64 selectable streams
+// (pcg64 has 2^127, but they are not needed in practice), each has period 2^128
+SHLAG_PCG_DEF void shlag_pcg64_srand(shlag_pcg64* rng, uint64_t initstate, uint64_t initseq);
+// gen random u64
+SHLAG_PCG_DEF uint64_t shlag_pcg64_rand(shlag_pcg64* rng);
+// gen random u64 in range <0, @end) (Lemire's method with 128bit product). If @end==0, return 0.
+SHLAG_PCG_DEF uint64_t shlag_pcg64_randrange0(shlag_pcg64* rng, uint64_t end);
+// gen random u64 in range <@begin, @end). If @begin==@end, return that number
+SHLAG_PCG_DEF uint64_t shlag_pcg64_randrange(shlag_pcg64* rng, uint64_t begin, uint64_t end);
+// Advance rng by 128bit delta = @deltaHi*2^64 + @deltaLo steps in O(log(delta)) time.
+// Like in pcg32, you can go backwards by passing -steps (as 128bit number)
+SHLAG_PCG_DEF void shlag_pcg64_advance(shlag_pcg64* rng, uint64_t deltaHi, uint64_t deltaLo);
+// Same as shlag_pcg32_split(), but substreams are 2^64 numbers long, and there are 2^64 of them
+SHLAG_PCG_DEF void shlag_pcg64_split(const shlag_pcg64* rng, shlag_pcg64* subs, uint64_t first, uint32_t n);
+// Same as shlag_pcg32_shuffle() and shlag_pcg32_sample(), but 64bit number is one call, so
+// each batch of 2-6 indices costs half of what it does there
+SHLAG_PCG_DEF void shlag_pcg64_shuffle(shlag_pcg64* rng, void* arr, size_t n, size_t size);
+SHLAG_PCG_DEF void shlag_pcg64_sample(shlag_pcg64* rng, void* arr, size_t n, size_t size, size_t k);
+
 #ifdef __cplusplus
  }
 #endif
@@ -67,8 +204,18 @@ SHLAG_PCG_DEF uint32_t shlag_pcg32_randrange(shlag_pcg32* rng, uint32_t begin, u
 
 
 #ifdef SHLAG_PCG_IMPL
+#include <string.h>
 
-SHLAG_PCG_DEF void shlag_pcg32_srand(shlag_pcg32* rng, uint64_t initstate, uint64_t initseq)
+// IMPLDEF is same as SHLAG_PCG_DEF, but with silenced warnings about unused static functions
+#if defined(__GNUC__)
+ #define SHLAG_PCG_IMPLDEF SHLAG_PCG_DEF __attribute__((unused))
+ #define SHLAG_PCG_INLINE static inline __attribute__((always_inline))
+#else
+ #define SHLAG_PCG_IMPLDEF SHLAG_PCG_DEF
+ #define SHLAG_PCG_INLINE static inline
+#endif
+
+SHLAG_PCG_IMPLDEF void shlag_pcg32_srand(shlag_pcg32* rng, uint64_t initstate, uint64_t initseq)
 {
     rng->state = 0U;
     rng->inc = (initseq << 1u) | 1u;
@@ -77,7 +224,7 @@ SHLAG_PCG_DEF void shlag_pcg32_srand(shlag_pcg32* rng, uint64_t initstate, uint6
     shlag_pcg32_rand(rng);
 }
 
-SHLAG_PCG_DEF uint32_t shlag_pcg32_rand(shlag_pcg32* rng) {
+SHLAG_PCG_IMPLDEF uint32_t shlag_pcg32_rand(shlag_pcg32* rng) {
     uint64_t oldstate = rng->state;
     rng->state = oldstate * 6364136223846793005ULL + rng->inc;
     uint32_t xorshifted = ((oldstate >> 18u) ^ oldstate) >> 27u;
@@ -85,7 +232,7 @@ SHLAG_PCG_DEF uint32_t shlag_pcg32_rand(shlag_pcg32* rng) {
     return (xorshifted >> rot) | (xorshifted << ((-rot) & 31));
 }
 
-SHLAG_PCG_DEF uint32_t shlag_pcg32_randrange0(shlag_pcg32* rng, uint32_t end) {
+SHLAG_PCG_IMPLDEF uint32_t shlag_pcg32_randrange0(shlag_pcg32* rng, uint32_t end) {
     uint64_t random32bit, multiresult;
     uint32_t leftover;
     uint32_t threshold;
@@ -103,12 +250,516 @@ SHLAG_PCG_DEF uint32_t shlag_pcg32_randrange0(shlag_pcg32* rng, uint32_t end) {
     return multiresult >> 32; // <0, end)
 }
 
-SHLAG_PCG_DEF uint32_t shlag_pcg32_randrange(shlag_pcg32* rng, uint32_t begin, uint32_t end)
+SHLAG_PCG_IMPLDEF uint32_t shlag_pcg32_randrange(shlag_pcg32* rng, uint32_t begin, uint32_t end)
 {
     const uint32_t rangesize = end-begin;
     return begin + shlag_pcg32_randrange0(rng, rangesize);
 }
 
+SHLAG_PCG_IMPLDEF void shlag_pcg32_fill(shlag_pcg32* rng, uint32_t* buf, size_t n)
+{
+    shlag_pcg32 local = *rng; // keep state in register, compiler can't prove that buf doesn't alias it
+    for(size_t i = 0; i < n; ++i) buf[i] = shlag_pcg32_rand(&local);
+    *rng = local;
+}
+
+SHLAG_PCG_IMPLDEF shlag_pcg32_bounded shlag_pcg32_bounded_init(uint32_t begin, uint32_t end)
+{
+    shlag_pcg32_bounded bounded;
+    bounded.begin = begin;
+    bounded.range = end - begin;
+    // randrange0() computes it lazily, just when leftover < range. Since threshold < range,
+    // checking leftover < threshold straight away rejects exactly same numbers
+    bounded.threshold = bounded.range ? -bounded.range % bounded.range : 0;
+    return bounded;
+}
+
+SHLAG_PCG_IMPLDEF uint32_t shlag_pcg32_bounded_rand(shlag_pcg32* rng, const shlag_pcg32_bounded* bounded)
+{
+    uint64_t multiresult;
+    do {
+        multiresult = (uint64_t)shlag_pcg32_rand(rng) * bounded->range;
+    } while((uint32_t)multiresult < bounded->threshold);
+    return bounded->begin + (uint32_t)(multiresult >> 32);
+}
+
+SHLAG_PCG_IMPLDEF void shlag_pcg32_fillrange(shlag_pcg32* rng, uint32_t* buf, size_t n, uint32_t begin, uint32_t end)
+{
+    const shlag_pcg32_bounded bounded = shlag_pcg32_bounded_init(begin, end);
+    shlag_pcg32 local = *rng;
+    for(size_t i = 0; i < n; ++i) buf[i] = shlag_pcg32_bounded_rand(&local, &bounded);
+    *rng = local;
+}
+
+// 64x64 -> 128bit mul. Returns low half, stores high half in @hi
+static inline uint64_t shlag_pcg_mul64(uint64_t a, uint64_t b, uint64_t* hi)
+{
+#ifdef __SIZEOF_INT128__
+    __uint128_t m = (__uint128_t)a * b;
+    *hi = m >> 64;
+    return (uint64_t)m;
+#else
+    uint64_t al = (uint32_t)a, ah = a >> 32, bl = (uint32_t)b, bh = b >> 32;
+    uint64_t ll = al * bl, lh = al * bh, hl = ah * bl, hh = ah * bh;
+    uint64_t mid = (ll >> 32) + (uint32_t)lh + (uint32_t)hl;
+    *hi = hh + (lh >> 32) + (hl >> 32) + (mid >> 32);
+    return (mid << 32) | (uint32_t)ll;
+#endif
+}
+
+static inline uint64_t shlag_pcg_rand64(shlag_pcg32* rng)
+{
+    uint64_t hi = shlag_pcg32_rand(rng);
+    return hi << 32 | shlag_pcg32_rand(rng);
+}
+
+// Generator used by shuffle and sampling, exactly one of them is set. Code below is always
+// inlined with one of them being NULL, so checking which one it is folds away
+typedef struct shlag_pcg_gen {
+    shlag_pcg32* g32;
+    shlag_pcg64* g64;
+} shlag_pcg_gen;
+
+SHLAG_PCG_INLINE uint64_t shlag_pcg_gen_rand64(shlag_pcg_gen gen)
+{
+    return gen.g64 ? shlag_pcg64_rand(gen.g64) : shlag_pcg_rand64(gen.g32);
+}
+
+// Draw @k numbers from single 64bit random number: @out[t] is in <0, @n - t).
+// Product of ranges has to fit in 64 bits
+SHLAG_PCG_INLINE void shlag_pcg_dice(shlag_pcg_gen gen, uint64_t n, const int k, uint64_t* out)
+{
+    uint64_t product = n;
+    for(int t = 1; t < k; ++t) product *= n - t;
+    for(;;) {
+        uint64_t leftover = shlag_pcg_gen_rand64(gen);
+        for(int t = 0; t < k; ++t) leftover = shlag_pcg_mul64(leftover, n - t, &out[t]);
+        // like in randrange0(), but whole batch is rejected. threshold < product, so
+        // expensive division is rarely computed
+        if(leftover >= product || leftover >= -product % product) return;
+    }
+}
+
+SHLAG_PCG_INLINE void shlag_pcg_swap(unsigned char* a, unsigned char* b, const size_t size)
+{
+    unsigned char tmp[64];
+    for(size_t off = 0; off < size; off += sizeof(tmp)) { // constant size makes it few movs
+        size_t len = size - off < sizeof(tmp) ? size - off : sizeof(tmp);
+        memcpy(tmp, a + off, len);
+        memmove(a + off, b + off, len); // a == b if element is swapped with itself
+        memcpy(b + off, tmp, len);
+    }
+}
+
+// Do @k steps of Fisher-Yates, starting from i-th element, with indices from single dice() roll
+SHLAG_PCG_INLINE void shlag_pcg_shuffle_steps(shlag_pcg_gen gen, unsigned char* arr,
+        size_t n, const size_t size, size_t i, const int k)
+{
+    uint64_t idx[6];
+    shlag_pcg_dice(gen, n - i, k, idx);
+    for(int t = 0; t < k; ++t, ++i) {
+        shlag_pcg_swap(arr + i * size, arr + (i + idx[t]) * size, size);
+    }
+}
+
+// Move @k random elements to front of @arr, one by one. Ranges of consecutive steps
+// get smaller, so we draw more indices at once as they do (cutoffs are from paper).
+// Exactly one of @orig32 and @orig64 is set
+SHLAG_PCG_INLINE void shlag_pcg_partial_shuffle(shlag_pcg32* orig32, shlag_pcg64* orig64,
+        unsigned char* arr, size_t n, const size_t size, size_t k)
+{
+    // keep state in registers, arr could alias it
+    shlag_pcg32 local32;
+    shlag_pcg64 local64;
+    shlag_pcg_gen gen = {NULL, NULL};
+    if(orig64) { local64 = *orig64; gen.g64 = &local64; }
+    else { local32 = *orig32; gen.g32 = &local32; }
+    size_t i = 0;
+    // ranges that don't fit in 32 bits (or above batching cutoff, for pcg64) - one per number
+    for(; i < k && n - i > (orig64 ? (1 << 30) : UINT32_MAX); ++i) {
+        uint64_t j;
+        shlag_pcg_dice(gen, n - i, 1, &j);
+        shlag_pcg_swap(arr + i * size, arr + (i + j) * size, size);
+    }
+    for(; !orig64 && i < k && n - i > (1 << 30); ++i) { // single 32bit draw is cheaper than 64bit one
+        uint32_t j = shlag_pcg32_randrange0(gen.g32, n - i);
+        shlag_pcg_swap(arr + i * size, arr + (i + j) * size, size);
+    }
+    // unrolled for each batch size, so idx[] lives in registers
+    for(; i + 2 <= k && n - i > (1 << 19); i += 2) shlag_pcg_shuffle_steps(gen, arr, n, size, i, 2);
+    for(; i + 3 <= k && n - i > (1 << 14); i += 3) shlag_pcg_shuffle_steps(gen, arr, n, size, i, 3);
+    for(; i + 4 <= k && n - i > (1 << 11); i += 4) shlag_pcg_shuffle_steps(gen, arr, n, size, i, 4);
+    for(; i + 5 <= k && n - i > (1 << 9); i += 5) shlag_pcg_shuffle_steps(gen, arr, n, size, i, 5);
+    for(; i + 6 <= k; i += 6) shlag_pcg_shuffle_steps(gen, arr, n, size, i, 6);
+    for(; i < k; ++i) shlag_pcg_shuffle_steps(gen, arr, n, size, i, 1); // tail of partial shuffle
+    if(orig64) *orig64 = local64;
+    else *orig32 = local32;
+}
+
+SHLAG_PCG_INLINE void shlag_pcg_sample(shlag_pcg32* rng32, shlag_pcg64* rng64,
+        void* arr, size_t n, size_t size, size_t k)
+{
+    if(k >= n) k = n ? n - 1 : 0; // last element has nowhere to go
+    switch(size) { // specialize common sizes, so swap isn't byte loop
+        case 4: shlag_pcg_partial_shuffle(rng32, rng64, (unsigned char*)arr, n, 4, k); break;
+        case 8: shlag_pcg_partial_shuffle(rng32, rng64, (unsigned char*)arr, n, 8, k); break;
+        default: shlag_pcg_partial_shuffle(rng32, rng64, (unsigned char*)arr, n, size, k); break;
+    }
+}
+
+SHLAG_PCG_IMPLDEF void shlag_pcg32_sample(shlag_pcg32* rng, void* arr, size_t n, size_t size, size_t k)
+{
+    shlag_pcg_sample(rng, NULL, arr, n, size, k);
+}
+
+SHLAG_PCG_IMPLDEF void shlag_pcg32_shuffle(shlag_pcg32* rng, void* arr, size_t n, size_t size)
+{
+    shlag_pcg32_sample(rng, arr, n, size, n);
+}
+
+// Algorithm R: item number t replaces random slot with probability k/(t+1)
+SHLAG_PCG_IMPLDEF int64_t shlag_pcg32_reservoir_add(shlag_pcg32* rng, shlag_pcg32_reservoir* res)
+{
+    const uint64_t t = res->seen++;
+    if(t < res->k) return t;
+    uint64_t j;
+    if(t < UINT32_MAX) j = shlag_pcg32_randrange0(rng, t + 1);
+    else {
+        shlag_pcg_gen gen = {rng, NULL};
+        shlag_pcg_dice(gen, t + 1, 1, &j);
+    }
+    return j < res->k ? (int64_t)j : -1;
+}
+
+// 1/2^24 and 1/2^53, hex float literals would be nicer, but C++ < 17 doesn't have them
+#define SHLAG_PCG_FLOAT_UNIT (1.0f / 16777216.0f)
+#define SHLAG_PCG_DOUBLE_UNIT (1.0 / 9007199254740992.0)
+
+// both int64 -> double conversions are exact, and signed ones are cheaper (and vectorize)
+SHLAG_PCG_INLINE float shlag_pcg_tofloat(uint32_t r)
+{
+    return (int32_t)(r >> 8) * SHLAG_PCG_FLOAT_UNIT;
+}
+
+SHLAG_PCG_INLINE double shlag_pcg_todouble(uint64_t r)
+{
+    return (int64_t)(r >> 11) * SHLAG_PCG_DOUBLE_UNIT;
+}
+
+SHLAG_PCG_IMPLDEF float shlag_pcg32_randf(shlag_pcg32* rng)
+{
+    return shlag_pcg_tofloat(shlag_pcg32_rand(rng));
+}
+
+SHLAG_PCG_IMPLDEF double shlag_pcg32_randd(shlag_pcg32* rng)
+{
+    return shlag_pcg_todouble(shlag_pcg_rand64(rng));
+}
+
+SHLAG_PCG_IMPLDEF float shlag_pcg32_randf_range(shlag_pcg32* rng, float begin, float end)
+{
+    return begin + (end - begin) * shlag_pcg32_randf(rng);
+}
+
+SHLAG_PCG_IMPLDEF double shlag_pcg32_randd_range(shlag_pcg32* rng, double begin, double end)
+{
+    return begin + (end - begin) * shlag_pcg32_randd(rng);
+}
+
+// Generating is serial anyway, so do it into small buffer, and then convert it in
+// separate loop, that compiler can vectorize (constant trip count helps gcc -O2 do that)
+#define SHLAG_PCG_CHUNK 256
+
+SHLAG_PCG_INLINE void shlag_pcg_fillf_chunk(shlag_pcg32* rng, float* buf, const size_t len)
+{
+    uint32_t raw[SHLAG_PCG_CHUNK];
+    shlag_pcg32_fill(rng, raw, len);
+    for(size_t i = 0; i < len; ++i) buf[i] = shlag_pcg_tofloat(raw[i]);
+}
+
+SHLAG_PCG_INLINE void shlag_pcg_filld_chunk(shlag_pcg32* rng, double* buf, const size_t len)
+{
+    uint32_t raw[SHLAG_PCG_CHUNK];
+    shlag_pcg32_fill(rng, raw, 2 * len);
+    for(size_t i = 0; i < len; ++i) buf[i] = shlag_pcg_todouble((uint64_t)raw[2*i] << 32 | raw[2*i+1]);
+}
+
+SHLAG_PCG_IMPLDEF void shlag_pcg32_fillf(shlag_pcg32* rng, float* buf, size_t n)
+{
+    for(; n >= SHLAG_PCG_CHUNK; n -= SHLAG_PCG_CHUNK, buf += SHLAG_PCG_CHUNK) {
+        shlag_pcg_fillf_chunk(rng, buf, SHLAG_PCG_CHUNK);
+    }
+    shlag_pcg_fillf_chunk(rng, buf, n);
+}
+
+SHLAG_PCG_IMPLDEF void shlag_pcg32_filld(shlag_pcg32* rng, double* buf, size_t n)
+{
+    for(; n >= SHLAG_PCG_CHUNK / 2; n -= SHLAG_PCG_CHUNK / 2, buf += SHLAG_PCG_CHUNK / 2) {
+        shlag_pcg_filld_chunk(rng, buf, SHLAG_PCG_CHUNK / 2);
+    }
+    shlag_pcg_filld_chunk(rng, buf, n);
+}
+
+#ifdef SHLAG_PCG_NORMAL
+#include <math.h>
+// 128 layers. R is where tail starts, V is area of each layer (Marsaglia & Tsang)
+#define SHLAG_PCG_ZIG_R 3.442619855899
+#define SHLAG_PCG_ZIG_V 9.91256303526217e-3
+
+SHLAG_PCG_IMPLDEF void shlag_pcg_ziggurat_init(shlag_pcg_ziggurat* zig)
+{
+    double f = exp(-0.5 * SHLAG_PCG_ZIG_R * SHLAG_PCG_ZIG_R);
+    zig->x[0] = SHLAG_PCG_ZIG_V / f; // bottom layer is rectangle + tail, so pretend it is wider
+    zig->x[1] = SHLAG_PCG_ZIG_R;
+    zig->x[128] = 0;
+    for(int i = 2; i < 128; ++i) {
+        zig->x[i] = sqrt(-2 * log(SHLAG_PCG_ZIG_V / zig->x[i-1] + f));
+        f = exp(-0.5 * zig->x[i] * zig->x[i]);
+    }
+    for(int i = 0; i < 128; ++i) zig->r[i] = zig->x[i+1] / zig->x[i];
+}
+
+SHLAG_PCG_IMPLDEF double shlag_pcg32_normal(shlag_pcg32* rng, const shlag_pcg_ziggurat* zig)
+{
+    for(;;) {
+        // single 64bit draw: top 53 bits make u in <-1, 1), low 7 bits pick layer
+        uint64_t r = shlag_pcg_rand64(rng);
+        double u = 2 * shlag_pcg_todouble(r) - 1;
+        unsigned i = r & 0x7f;
+        if(fabs(u) < zig->r[i]) return u * zig->x[i]; // inside rectangle, ~99% of cases
+        if(i == 0) { // tail, x > R (Marsaglia's method). 1 - randd() is in (0, 1], so log() is finite
+            double x, y;
+            do {
+                x = log(1 - shlag_pcg32_randd(rng)) / SHLAG_PCG_ZIG_R;
+                y = log(1 - shlag_pcg32_randd(rng));
+            } while(-2 * y < x * x);
+            return u < 0 ? x - SHLAG_PCG_ZIG_R : SHLAG_PCG_ZIG_R - x;
+        }
+        // wedge between rectangle and curve
+        double x = u * zig->x[i];
+        double f0 = exp(-0.5 * (zig->x[i] * zig->x[i] - x * x));
+        double f1 = exp(-0.5 * (zig->x[i+1] * zig->x[i+1] - x * x));
+        if(f1 + shlag_pcg32_randd(rng) * (f0 - f1) < 1.0) return x;
+    }
+}
+#endif // SHLAG_PCG_NORMAL
+
+// Jump LCG ahead, by treating step as affine map and squaring it (see "Random Number
+// Generation with Arbitrary Stride" by F. Brown). Taken from pcg-c
+SHLAG_PCG_IMPLDEF void shlag_pcg32_advance(shlag_pcg32* rng, uint64_t delta)
+{
+    uint64_t curMult = 6364136223846793005ULL, curPlus = rng->inc;
+    uint64_t accMult = 1u, accPlus = 0u;
+    while(delta > 0) {
+        if(delta & 1) {
+            accMult *= curMult;
+            accPlus = accPlus * curMult + curPlus;
+        }
+        curPlus = (curMult + 1) * curPlus;
+        curMult *= curMult;
+        delta /= 2;
+    }
+    rng->state = accMult * rng->state + accPlus;
+}
+
+SHLAG_PCG_IMPLDEF void shlag_pcg32_split(const shlag_pcg32* rng, shlag_pcg32* subs, uint32_t first, uint32_t n)
+{
+    for(uint32_t i = 0; i < n; ++i) {
+        subs[i] = *rng;
+        shlag_pcg32_advance(&subs[i], (first + (uint64_t)i) * SHLAG_PCG32_SUBSTREAM_LEN);
+    }
+}
+
+SHLAG_PCG_IMPLDEF void shlag_pcg32x8_srand(shlag_pcg32x8* rng, const uint64_t initstate[8], const uint64_t initseq[8])
+{
+    shlag_pcg32 lanes[8];
+    for(int i = 0; i < 8; ++i) shlag_pcg32_srand(&lanes[i], initstate[i], initseq[i]);
+    shlag_pcg32x8_pack(rng, lanes);
+}
+
+SHLAG_PCG_IMPLDEF void shlag_pcg32x8_pack(shlag_pcg32x8* rng, const shlag_pcg32 lanes[8])
+{
+    for(int i = 0; i < 8; ++i) {
+        rng->state[i] = lanes[i].state;
+        rng->inc[i] = lanes[i].inc;
+    }
+}
+
+SHLAG_PCG_IMPLDEF shlag_pcg32 shlag_pcg32x8_lane(const shlag_pcg32x8* rng, unsigned i)
+{
+    shlag_pcg32 lane = {rng->state[i], rng->inc[i]};
+    return lane;
+}
+
+#ifdef __AVX2__
+#include <immintrin.h>
+// AVX2 has no 64bit mullo, so compose it from 32x32->64 muls: x*m mod 2^64 is
+// xl*ml + ((xl*mh + xh*ml) << 32)
+static inline __m256i shlag_pcg32x8_step(__m256i x, __m256i inc)
+{
+    const __m256i ml = _mm256_set1_epi64x(6364136223846793005ULL & 0xffffffff);
+    const __m256i mh = _mm256_set1_epi64x(6364136223846793005ULL >> 32);
+    __m256i lo = _mm256_mul_epu32(x, ml);
+    __m256i cross = _mm256_add_epi64(_mm256_mul_epu32(x, mh),
+            _mm256_mul_epu32(_mm256_srli_epi64(x, 32), ml));
+    return _mm256_add_epi64(_mm256_add_epi64(lo, _mm256_slli_epi64(cross, 32)), inc);
+}
+
+// output function of 4 lanes. Result is in low dword of each qword
+static inline __m256i shlag_pcg32x8_output(__m256i old)
+{
+    __m256i xorshifted = _mm256_srli_epi64(_mm256_xor_si256(_mm256_srli_epi64(old, 18), old), 27);
+    __m256i rot = _mm256_srli_epi64(old, 59);
+    // shift by 32 gives 0 in sllv, so rot == 0 just works
+    __m256i lrot = _mm256_sub_epi32(_mm256_set1_epi32(32), rot);
+    return _mm256_or_si256(_mm256_srlv_epi32(xorshifted, rot), _mm256_sllv_epi32(xorshifted, lrot));
+}
+
+SHLAG_PCG_IMPLDEF void shlag_pcg32x8_rand(shlag_pcg32x8* rng, uint32_t out[8])
+{
+    __m256i a = _mm256_loadu_si256((const __m256i*)rng->state);
+    __m256i b = _mm256_loadu_si256((const __m256i*)(rng->state + 4));
+    _mm256_storeu_si256((__m256i*)rng->state, shlag_pcg32x8_step(a, _mm256_loadu_si256((const __m256i*)rng->inc)));
+    _mm256_storeu_si256((__m256i*)(rng->state + 4), shlag_pcg32x8_step(b, _mm256_loadu_si256((const __m256i*)(rng->inc + 4))));
+    // interleave low dwords into [a0 b0 a1 b1 ...] and then sort them into lane order
+    __m256i ab = _mm256_blend_epi32(shlag_pcg32x8_output(a), _mm256_slli_epi64(shlag_pcg32x8_output(b), 32), 0xaa);
+    ab = _mm256_permutevar8x32_epi32(ab, _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7));
+    _mm256_storeu_si256((__m256i*)out, ab);
+}
+#else
+SHLAG_PCG_IMPLDEF void shlag_pcg32x8_rand(shlag_pcg32x8* rng, uint32_t out[8])
+{
+    // same as shlag_pcg32_rand(), but lanes don't depend on each other, so compiler
+    // may vectorize or at least interleave them
+#if defined(__GNUC__) && !defined(__clang__)
+    _Pragma("GCC unroll 8")
+#endif
+    for(int i = 0; i < 8; ++i) {
+        uint64_t oldstate = rng->state[i];
+        rng->state[i] = oldstate * 6364136223846793005ULL + rng->inc[i];
+        uint32_t xorshifted = ((oldstate >> 18u) ^ oldstate) >> 27u;
+        uint32_t rot = oldstate >> 59u;
+        out[i] = (xorshifted >> rot) | (xorshifted << ((-rot) & 31));
+    }
+}
+#endif
+
+// 128bit math for pcg64, on {hi, lo} pairs
+typedef struct shlag_pcg_u128{
+    uint64_t hi, lo;
+} shlag_pcg_u128;
+
+SHLAG_PCG_INLINE shlag_pcg_u128 shlag_pcg_u128_make(uint64_t hi, uint64_t lo)
+{
+    shlag_pcg_u128 r = {hi, lo};
+    return r;
+}
+
+SHLAG_PCG_INLINE shlag_pcg_u128 shlag_pcg_u128_add(shlag_pcg_u128 a, shlag_pcg_u128 b)
+{
+    shlag_pcg_u128 r;
+    r.lo = a.lo + b.lo;
+    r.hi = a.hi + b.hi + (r.lo < a.lo);
+    return r;
+}
+
+SHLAG_PCG_INLINE shlag_pcg_u128 shlag_pcg_u128_mul(shlag_pcg_u128 a, shlag_pcg_u128 b)
+{
+    shlag_pcg_u128 r;
+    r.lo = shlag_pcg_mul64(a.lo, b.lo, &r.hi);
+    r.hi += a.hi * b.lo + a.lo * b.hi;
+    return r;
+}
+
+#define SHLAG_PCG64_MULT shlag_pcg_u128_make(2549297995355413924ULL, 4865540595714422341ULL)
+
+SHLAG_PCG_INLINE void shlag_pcg64_step(shlag_pcg64* rng)
+{
+    shlag_pcg_u128 state = shlag_pcg_u128_make(rng->state[0], rng->state[1]);
+    state = shlag_pcg_u128_add(shlag_pcg_u128_mul(state, SHLAG_PCG64_MULT),
+            shlag_pcg_u128_make(rng->inc[0], rng->inc[1]));
+    rng->state[0] = state.hi;
+    rng->state[1] = state.lo;
+}
+
+SHLAG_PCG_IMPLDEF void shlag_pcg64_srand(shlag_pcg64* rng, uint64_t initstate, uint64_t initseq)
+{
+    rng->state[0] = rng->state[1] = 0;
+    rng->inc[0] = initseq >> 63;
+    rng->inc[1] = (initseq << 1u) | 1u;
+    shlag_pcg64_step(rng);
+    shlag_pcg_u128 state = shlag_pcg_u128_add(shlag_pcg_u128_make(rng->state[0], rng->state[1]),
+            shlag_pcg_u128_make(0, initstate));
+    rng->state[0] = state.hi;
+    rng->state[1] = state.lo;
+    shlag_pcg64_step(rng);
+}
+
+// unlike pcg32, pcg64 outputs permuted *new* state
+SHLAG_PCG_IMPLDEF uint64_t shlag_pcg64_rand(shlag_pcg64* rng)
+{
+    shlag_pcg64_step(rng);
+    uint64_t xored = rng->state[0] ^ rng->state[1];
+    unsigned rot = rng->state[0] >> 58u;
+    return (xored >> rot) | (xored << ((-rot) & 63));
+}
+
+SHLAG_PCG_IMPLDEF uint64_t shlag_pcg64_randrange0(shlag_pcg64* rng, uint64_t end)
+{
+    uint64_t result;
+    uint64_t leftover = shlag_pcg_mul64(shlag_pcg64_rand(rng), end, &result);
+    if(leftover < end) {
+        const uint64_t threshold = -end % end;
+        while(leftover < threshold) leftover = shlag_pcg_mul64(shlag_pcg64_rand(rng), end, &result);
+    }
+    return result; // <0, end)
+}
+
+SHLAG_PCG_IMPLDEF uint64_t shlag_pcg64_randrange(shlag_pcg64* rng, uint64_t begin, uint64_t end)
+{
+    return begin + shlag_pcg64_randrange0(rng, end - begin);
+}
+
+// same as shlag_pcg32_advance(), but on 128bit numbers
+SHLAG_PCG_IMPLDEF void shlag_pcg64_advance(shlag_pcg64* rng, uint64_t deltaHi, uint64_t deltaLo)
+{
+    shlag_pcg_u128 curMult = SHLAG_PCG64_MULT, curPlus = shlag_pcg_u128_make(rng->inc[0], rng->inc[1]);
+    shlag_pcg_u128 accMult = shlag_pcg_u128_make(0, 1), accPlus = shlag_pcg_u128_make(0, 0);
+    const shlag_pcg_u128 one = shlag_pcg_u128_make(0, 1);
+    while(deltaHi | deltaLo) {
+        if(deltaLo & 1) {
+            accMult = shlag_pcg_u128_mul(accMult, curMult);
+            accPlus = shlag_pcg_u128_add(shlag_pcg_u128_mul(accPlus, curMult), curPlus);
+        }
+        curPlus = shlag_pcg_u128_mul(shlag_pcg_u128_add(curMult, one), curPlus);
+        curMult = shlag_pcg_u128_mul(curMult, curMult);
+        deltaLo = (deltaLo >> 1) | (deltaHi << 63);
+        deltaHi >>= 1;
+    }
+    shlag_pcg_u128 state = shlag_pcg_u128_make(rng->state[0], rng->state[1]);
+    state = shlag_pcg_u128_add(shlag_pcg_u128_mul(accMult, state), accPlus);
+    rng->state[0] = state.hi;
+    rng->state[1] = state.lo;
+}
+
+SHLAG_PCG_IMPLDEF void shlag_pcg64_sample(shlag_pcg64* rng, void* arr, size_t n, size_t size, size_t k)
+{
+    shlag_pcg_sample(NULL, rng, arr, n, size, k);
+}
+
+SHLAG_PCG_IMPLDEF void shlag_pcg64_shuffle(shlag_pcg64* rng, void* arr, size_t n, size_t size)
+{
+    shlag_pcg64_sample(rng, arr, n, size, n);
+}
+
+SHLAG_PCG_IMPLDEF void shlag_pcg64_split(const shlag_pcg64* rng, shlag_pcg64* subs, uint64_t first, uint32_t n)
+{
+    for(uint32_t i = 0; i < n; ++i) {
+        subs[i] = *rng;
+        shlag_pcg64_advance(&subs[i], first + i, 0);
+    }
+}
+
 #endif // SHLAG_PCG_IMPL
 
 /*
@@ -0,0 +1,261 @@
+/* UTF-8 validator and decoder
+ *
+ * Validation uses lookup-table algorithm from "Validating UTF-8 In Less Than One
+ * Instruction Per Byte" (Keiser, Lemire): three nibble lookups catch all errors that
+ * can be seen in pair of bytes, and saturated subtractions check that 3 and 4 byte
+ * sequences have enough continuation bytes. If you compile with SSSE3 or AVX2 enabled,
+ * it runs on 16/32 bytes at once (GB/s), otherwise scalar code with ASCII fast path is used.
+ * Both reject everything that RFC 3629 rejects: overlongs, surrogates, codepoints above
+ * U+10FFFF, truncated sequences and stray continuation bytes.
+ *
+ * used namespaces: shlag_utf8, SHLAG_UTF8
+ *
+ * In *one* of C or C++ file, you have to define SHLAG_UTF8_IMPL before including
+ * shlag_utf8.h. See `shlag/examples/codepoint.c`
+ */
+
+#ifndef SHLAG_UTF8_H
+#define SHLAG_UTF8_H
+
+#include <stdint.h>
+
+// Prepend public function definitions with whatever you want. You can use it
+// for example to make functions static. By default it does nothing
+#ifndef SHLAG_UTF8_DEF
+ #define SHLAG_UTF8_DEF
+#endif
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+// Return length of longest valid prefix of @in, so it returns @len if whole @in is valid,
+// and offset of first byte of first invalid (or truncated) sequence otherwise
+SHLAG_UTF8_DEF int64_t shlag_utf8_validate(const char* in, int64_t len);
+
+// Decode @in into codepoints. @out has to have space for @len codepoints (each byte can be
+// separate codepoint). On success returns count of written codepoints. If @in is not valid
+// UTF-8 returns negative number (and @out content is unspecified)
+SHLAG_UTF8_DEF int64_t shlag_utf8_decode(const char* in, int64_t len, uint32_t* out);
+
+#ifdef __cplusplus
+ }
+#endif
+#endif // SHLAG_UTF8_H
+
+#ifdef SHLAG_UTF8_IMPL
+#include <string.h>
+#if defined(__AVX2__)
+ #include <immintrin.h>
+#elif defined(__SSSE3__)
+ #include <tmmintrin.h>
+#endif
+
+// IMPLDEF is same as SHLAG_UTF8_DEF, but with silenced warnings about unused static functions
+#if defined(__GNUC__)
+ #define SHLAG_UTF8_IMPLDEF SHLAG_UTF8_DEF __attribute__((unused))
+#else
+ #define SHLAG_UTF8_IMPLDEF SHLAG_UTF8_DEF
+#endif
+
+// validate @in starting from @i (which has to be start of sequence). Returns length of
+// longest valid prefix
+static int64_t shlag_utf8_validate_scalar(const uint8_t* in, int64_t i, int64_t len)
+{
+    while(i < len) {
+        uint64_t word;
+        if(i + 8 <= len && (memcpy(&word, in + i, 8), (word & 0x8080808080808080ULL) == 0)) {
+            i += 8; // 8 ASCII chars
+            continue;
+        }
+        const uint8_t c = in[i];
+        if(c < 0x80) { ++i; continue; }
+        int n; // sequence length
+        uint8_t lo = 0x80, hi = 0xBF; // allowed range of second byte (RFC 3629)
+        if(c >= 0xC2 && c <= 0xDF) n = 2;
+        else if(c >= 0xE0 && c <= 0xEF) {
+            n = 3;
+            if(c == 0xE0) lo = 0xA0; // overlong
+            else if(c == 0xED) hi = 0x9F; // surrogates
+        } else if(c >= 0xF0 && c <= 0xF4) {
+            n = 4;
+            if(c == 0xF0) lo = 0x90; // overlong
+            else if(c == 0xF4) hi = 0x8F; // above U+10FFFF
+        } else return i; // continuation, overlong 2 byte lead or 0xF5..0xFF
+        if(i + n > len || in[i+1] < lo || in[i+1] > hi) return i;
+        for(int k = 2; k < n; ++k) {
+            if((in[i+k] & 0xC0) != 0x80) return i;
+        }
+        i += n;
+    }
+    return len;
+}
+
+#if defined(__AVX2__) || defined(__SSSE3__)
+// Return start of last sequence that begins before @i (or @i itself if it isn't inside one)
+// Everything before it is known to be valid when vector kernel fails at @i
+static int64_t shlag_utf8_seq_start(const uint8_t* in, int64_t i)
+{
+    int64_t k = i;
+    while(k > 0 && i - k < 3 && (in[k-1] & 0xC0) == 0x80) --k;
+    if(k > 0 && in[k-1] >= 0xC0) --k;
+    return k;
+}
+
+// error bits of lookup tables. Byte pair is invalid if bits from all 3 lookups overlap
+#define SHLAG_UTF8_TOO_SHORT (1<<0) // 11______ 0_______ or 11______ 11______
+#define SHLAG_UTF8_TOO_LONG (1<<1) // 0_______ 10______
+#define SHLAG_UTF8_OVERLONG_3 (1<<2) // 11100000 100_____
+#define SHLAG_UTF8_TOO_LARGE (1<<3) // 11110100 1001____, 11110100 101_____, 11110101+ 1001____ ...
+#define SHLAG_UTF8_SURROGATE (1<<4) // 11101101 101_____
+#define SHLAG_UTF8_OVERLONG_2 (1<<5) // 1100000_ 10______
+#define SHLAG_UTF8_TOO_LARGE_1000 (1<<6) // 11110101+ 1000____
+#define SHLAG_UTF8_OVERLONG_4 (1<<6) // 11110000 1000____
+#define SHLAG_UTF8_TWO_CONTS (1<<7) // 10______ 10______ (ok if it is 3rd or 4th byte)
+#define SHLAG_UTF8_CARRY (SHLAG_UTF8_TOO_SHORT | SHLAG_UTF8_TOO_LONG | SHLAG_UTF8_TWO_CONTS)
+
+// tables indexed by high nibble of 1st byte, low nibble of 1st byte, high nibble of 2nd byte
+// (as arguments for _mm_setr_epi8)
+#define SHLAG_UTF8_BYTE1_HIGH \
+    SHLAG_UTF8_TOO_LONG, SHLAG_UTF8_TOO_LONG, SHLAG_UTF8_TOO_LONG, SHLAG_UTF8_TOO_LONG, \
+    SHLAG_UTF8_TOO_LONG, SHLAG_UTF8_TOO_LONG, SHLAG_UTF8_TOO_LONG, SHLAG_UTF8_TOO_LONG, \
+    SHLAG_UTF8_TWO_CONTS, SHLAG_UTF8_TWO_CONTS, SHLAG_UTF8_TWO_CONTS, SHLAG_UTF8_TWO_CONTS, \
+    SHLAG_UTF8_TOO_SHORT | SHLAG_UTF8_OVERLONG_2, \
+    SHLAG_UTF8_TOO_SHORT, \
+    SHLAG_UTF8_TOO_SHORT | SHLAG_UTF8_OVERLONG_3 | SHLAG_UTF8_SURROGATE, \
+    SHLAG_UTF8_TOO_SHORT | SHLAG_UTF8_TOO_LARGE | SHLAG_UTF8_TOO_LARGE_1000 | SHLAG_UTF8_OVERLONG_4
+#define SHLAG_UTF8_BIG (SHLAG_UTF8_CARRY | SHLAG_UTF8_TOO_LARGE | SHLAG_UTF8_TOO_LARGE_1000)
+#define SHLAG_UTF8_BYTE1_LOW \
+    SHLAG_UTF8_CARRY | SHLAG_UTF8_OVERLONG_3 | SHLAG_UTF8_OVERLONG_2 | SHLAG_UTF8_OVERLONG_4, \
+    SHLAG_UTF8_CARRY | SHLAG_UTF8_OVERLONG_2, \
+    SHLAG_UTF8_CARRY, \
+    SHLAG_UTF8_CARRY, \
+    SHLAG_UTF8_CARRY | SHLAG_UTF8_TOO_LARGE, \
+    SHLAG_UTF8_BIG, SHLAG_UTF8_BIG, SHLAG_UTF8_BIG, \
+    SHLAG_UTF8_BIG, SHLAG_UTF8_BIG, SHLAG_UTF8_BIG, SHLAG_UTF8_BIG, SHLAG_UTF8_BIG, \
+    SHLAG_UTF8_BIG | SHLAG_UTF8_SURROGATE, \
+    SHLAG_UTF8_BIG, SHLAG_UTF8_BIG
+#define SHLAG_UTF8_CONT_ERRS (SHLAG_UTF8_TOO_LONG | SHLAG_UTF8_OVERLONG_2 | SHLAG_UTF8_TWO_CONTS)
+#define SHLAG_UTF8_BYTE2_HIGH \
+    SHLAG_UTF8_TOO_SHORT, SHLAG_UTF8_TOO_SHORT, SHLAG_UTF8_TOO_SHORT, SHLAG_UTF8_TOO_SHORT, \
+    SHLAG_UTF8_TOO_SHORT, SHLAG_UTF8_TOO_SHORT, SHLAG_UTF8_TOO_SHORT, SHLAG_UTF8_TOO_SHORT, \
+    SHLAG_UTF8_CONT_ERRS | SHLAG_UTF8_OVERLONG_3 | SHLAG_UTF8_TOO_LARGE_1000 | SHLAG_UTF8_OVERLONG_4, \
+    SHLAG_UTF8_CONT_ERRS | SHLAG_UTF8_OVERLONG_3 | SHLAG_UTF8_TOO_LARGE, \
+    SHLAG_UTF8_CONT_ERRS | SHLAG_UTF8_SURROGATE | SHLAG_UTF8_TOO_LARGE, \
+    SHLAG_UTF8_CONT_ERRS | SHLAG_UTF8_SURROGATE | SHLAG_UTF8_TOO_LARGE, \
+    SHLAG_UTF8_TOO_SHORT, SHLAG_UTF8_TOO_SHORT, SHLAG_UTF8_TOO_SHORT, SHLAG_UTF8_TOO_SHORT
+// last 3 bytes of block can't be above it, unless sequence continues in next block
+#define SHLAG_UTF8_MAX_LAST \
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, (char)(0xF0-1), (char)(0xE0-1), (char)(0xC0-1)
+#endif
+
+#if defined(__AVX2__)
+#define SHLAG_UTF8_VEC_BYTES 32
+typedef __m256i shlag_utf8_vec;
+// @in shifted by @n bytes, with last bytes of @prev shifted in
+#define shlag_utf8_prev(in, prev, n) \
+    _mm256_alignr_epi8((in), _mm256_permute2x128_si256((prev), (in), 0x21), 16 - (n))
+#define shlag_utf8_lookup(tbl, idx) _mm256_shuffle_epi8(_mm256_setr_epi8(tbl, tbl), (idx))
+
+static inline shlag_utf8_vec shlag_utf8_block_errors(shlag_utf8_vec in, shlag_utf8_vec prev)
+{
+    const __m256i nibble = _mm256_set1_epi8(0x0F);
+    const __m256i prev1 = shlag_utf8_prev(in, prev, 1);
+    const __m256i sc = _mm256_and_si256(_mm256_and_si256(
+        shlag_utf8_lookup(SHLAG_UTF8_BYTE1_HIGH, _mm256_and_si256(_mm256_srli_epi16(prev1, 4), nibble)),
+        shlag_utf8_lookup(SHLAG_UTF8_BYTE1_LOW, _mm256_and_si256(prev1, nibble))),
+        shlag_utf8_lookup(SHLAG_UTF8_BYTE2_HIGH, _mm256_and_si256(_mm256_srli_epi16(in, 4), nibble)));
+    // only bytes after 111_____ (2 back) or 1111____ (3 back) can (and must) be 2nd continuation
+    const __m256i is3 = _mm256_subs_epu8(shlag_utf8_prev(in, prev, 2), _mm256_set1_epi8(0xE0 - 0x80));
+    const __m256i is4 = _mm256_subs_epu8(shlag_utf8_prev(in, prev, 3), _mm256_set1_epi8(0xF0 - 0x80));
+    const __m256i must23 = _mm256_and_si256(_mm256_or_si256(is3, is4), _mm256_set1_epi8((char)0x80));
+    return _mm256_xor_si256(must23, sc);
+}
+#define shlag_utf8_load(ptr) _mm256_loadu_si256((const __m256i*)(ptr))
+#define shlag_utf8_any(v) (!_mm256_testz_si256((v), (v)))
+#define shlag_utf8_ascii(v) (_mm256_movemask_epi8(v) == 0)
+#define shlag_utf8_incomplete(v) _mm256_subs_epu8((v), _mm256_setr_epi8(SHLAG_UTF8_MAX_LAST, SHLAG_UTF8_MAX_LAST))
+#define shlag_utf8_zero() _mm256_setzero_si256()
+
+#elif defined(__SSSE3__)
+#define SHLAG_UTF8_VEC_BYTES 16
+typedef __m128i shlag_utf8_vec;
+#define shlag_utf8_prev(in, prev, n) _mm_alignr_epi8((in), (prev), 16 - (n))
+#define shlag_utf8_lookup(tbl, idx) _mm_shuffle_epi8(_mm_setr_epi8(tbl), (idx))
+
+static inline shlag_utf8_vec shlag_utf8_block_errors(shlag_utf8_vec in, shlag_utf8_vec prev)
+{
+    const __m128i nibble = _mm_set1_epi8(0x0F);
+    const __m128i prev1 = shlag_utf8_prev(in, prev, 1);
+    const __m128i sc = _mm_and_si128(_mm_and_si128(
+        shlag_utf8_lookup(SHLAG_UTF8_BYTE1_HIGH, _mm_and_si128(_mm_srli_epi16(prev1, 4), nibble)),
+        shlag_utf8_lookup(SHLAG_UTF8_BYTE1_LOW, _mm_and_si128(prev1, nibble))),
+        shlag_utf8_lookup(SHLAG_UTF8_BYTE2_HIGH, _mm_and_si128(_mm_srli_epi16(in, 4), nibble)));
+    // only bytes after 111_____ (2 back) or 1111____ (3 back) can (and must) be 2nd continuation
+    const __m128i is3 = _mm_subs_epu8(shlag_utf8_prev(in, prev, 2), _mm_set1_epi8(0xE0 - 0x80));
+    const __m128i is4 = _mm_subs_epu8(shlag_utf8_prev(in, prev, 3), _mm_set1_epi8(0xF0 - 0x80));
+    const __m128i must23 = _mm_and_si128(_mm_or_si128(is3, is4), _mm_set1_epi8((char)0x80));
+    return _mm_xor_si128(must23, sc);
+}
+#define shlag_utf8_load(ptr) _mm_loadu_si128((const __m128i*)(ptr))
+#define shlag_utf8_any(v) (_mm_movemask_epi8(_mm_cmpeq_epi8((v), _mm_setzero_si128())) != 0xFFFF)
+#define shlag_utf8_ascii(v) (_mm_movemask_epi8(v) == 0)
+#define shlag_utf8_incomplete(v) _mm_subs_epu8((v), _mm_setr_epi8(SHLAG_UTF8_MAX_LAST))
+#define shlag_utf8_zero() _mm_setzero_si128()
+#endif
+
+SHLAG_UTF8_IMPLDEF int64_t shlag_utf8_validate(const char* str, int64_t len)
+{
+    const uint8_t* in = (const uint8_t*)str;
+    int64_t i = 0;
+#ifdef SHLAG_UTF8_VEC_BYTES
+    shlag_utf8_vec prev = shlag_utf8_zero(), prevIncomplete = shlag_utf8_zero();
+    for(; i + SHLAG_UTF8_VEC_BYTES <= len; i += SHLAG_UTF8_VEC_BYTES) {
+        const shlag_utf8_vec block = shlag_utf8_load(in + i);
+        shlag_utf8_vec err;
+        if(shlag_utf8_ascii(block)) {
+            err = prevIncomplete; // ASCII is fine, unless previous block ended mid-sequence
+        } else {
+            err = shlag_utf8_block_errors(block, prev);
+            prevIncomplete = shlag_utf8_incomplete(block);
+        }
+        // kernel only knows that something is wrong around this block, scalar code finds where
+        if(shlag_utf8_any(err)) break;
+        prev = block;
+    }
+    i = shlag_utf8_seq_start(in, i); // sequence crossing into tail is checked by scalar code
+#endif
+    return shlag_utf8_validate_scalar(in, i, len);
+}
+
+SHLAG_UTF8_IMPLDEF int64_t shlag_utf8_decode(const char* str, int64_t len, uint32_t* out)
+{
+    if(shlag_utf8_validate(str, len) != len) return -1;
+    const uint8_t* in = (const uint8_t*)str;
+    uint32_t* const outStart = out;
+    int64_t i = 0;
+    while(i < len) {
+        uint64_t word;
+        if(i + 8 <= len && (memcpy(&word, in + i, 8), (word & 0x8080808080808080ULL) == 0)) {
+            for(int k = 0; k < 8; ++k) out[k] = in[i+k];
+            out += 8; i += 8;
+            continue;
+        }
+        // input is valid, so lead byte alone tells sequence length
+        const uint8_t c = in[i];
+        if(c < 0x80) {
+            *out++ = c; i += 1;
+        } else if(c < 0xE0) {
+            *out++ = (uint32_t)(c & 0x1F) << 6 | (in[i+1] & 0x3F); i += 2;
+        } else if(c < 0xF0) {
+            *out++ = (uint32_t)(c & 0x0F) << 12 | (uint32_t)(in[i+1] & 0x3F) << 6 | (in[i+2] & 0x3F);
+            i += 3;
+        } else {
+            *out++ = (uint32_t)(c & 0x07) << 18 | (uint32_t)(in[i+1] & 0x3F) << 12
+                | (uint32_t)(in[i+2] & 0x3F) << 6 | (in[i+3] & 0x3F);
+            i += 4;
+        }
+    }
+    return out - outStart;
+}
+#endif // SHLAG_UTF8_IMPL
@@ -0,0 +1,204 @@
+// Throughput benchmark for shlag_b64. Output mimics google benchmark's console output, so
+// you can pipe it into `scripts/gmintbl` and compare compilers, commits or kernels, e.g:
+// ./b64bench | gmintbl scalar > out
+// ./b64bench_simd | gmintbl simd | join out - | column -t
+//
+// Usage: b64bench [max_size [filter]]
+// max_size defaults to 1GiB (you need ~5x that much memory, so meson passes 64MiB), filter
+// is substring of benchmark names to run. Names are:
+// {enc,dec}_{outplace,inplace}[_unpadded]_{hot,cold}/size
+// Hot benchmarks run on same buffer all the time. Cold ones walk (in random order)
+// through pool of buffers that is way bigger than cache, so each run starts with cold data.
+// Sizes are powers of 4, so encoded input always ends with "==" (or nothing when unpadded)
+// Inplace runs overwrite their input, so it has to be restored before each run. Time of that
+// memcpy is measured separately (same slots, same order) and subtracted, so inplace and
+// outplace numbers are comparable. In cold ones copy also pulls input into cache, so they
+// are closer to "cold output, warm input"
+//
+// To build it without buildsystem, run something like:
+// cc -O2 -I. tests/b64bench.c -o bin/b64bench
+#define SHLAG_B64_IMPL
+#include "shlag_b64.h"
+#define SHLAG_PCG_IMPL
+#include "shlag_pcg.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define POOL_SIZE ((int64_t)256 << 20) // size of cold buffer pool, has to be way bigger than LLC
+#define MIN_TIME 0.2 // seconds spent in each benchmark (more or less)
+
+typedef struct Bench {
+    const char* name;
+    bool dec, inplace, unpadded, cold;
+} Bench;
+
+static double now(clockid_t clk)
+{
+    struct timespec t;
+    clock_gettime(clk, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+// Benchmark state. Input and output of n-th run are at in + slot[n]*stride, out + slot[n]*stride
+typedef struct Ctx {
+    Bench b;
+    int64_t size; // size of plain data
+    uint8_t* plain; // pristine copy of plain data
+    char* encoded; // pristine copy of encoded data
+    int64_t encLen;
+    uint8_t* in; // buffers that are actually used (in == out when inplace)
+    uint8_t* out;
+    int64_t stride;
+    int64_t* slots;
+    int64_t nslots;
+} Ctx;
+
+static volatile uint8_t sink; // keeps results from being optimized away
+
+// with @codec == false, only restores inputs of inplace runs (to measure cost of that)
+static void run(Ctx* c, int64_t iters, bool codec)
+{
+    uint8_t acc = 0;
+    for(int64_t i = 0; i < iters; ++i) {
+        const int64_t off = c->slots[i % c->nslots] * c->stride;
+        uint8_t* in = c->in + off;
+        uint8_t* out = c->out + off;
+        if(c->b.inplace) { // restore input, it was overwritten by previous run
+            if(c->b.dec) memcpy(in, c->encoded, c->encLen);
+            else memcpy(in, c->plain, c->size);
+        }
+        if(!codec) {
+            acc += in[0];
+            continue;
+        }
+        if(c->b.dec) {
+            acc += (uint8_t)shlag_b64dec((char*)in, c->encLen, out);
+        } else {
+            shlag_b64enc(in, c->size, (char*)out);
+        }
+        acc += out[0];
+    }
+    sink = acc;
+}
+
+// allocate buffer, so its pages are really mapped before we time anything
+static void* alloc(int64_t n)
+{
+    void* p = malloc(n);
+    if(p) memset(p, 0, n);
+    return p;
+}
+
+// returns false if there is not enough memory
+static bool bench(Bench b, int64_t size, shlag_pcg32* rng)
+{
+    Ctx c = {.b = b, .size = size};
+    c.plain = alloc(size);
+    c.encoded = alloc(SHLAG_B64_ENCSIZE(size));
+    if(!c.plain || !c.encoded) return false;
+    for(int64_t i = 0; i < size; ++i) c.plain[i] = shlag_pcg32_rand(rng);
+    shlag_b64enc(c.plain, size, c.encoded);
+    c.encLen = SHLAG_B64_ENCSIZE(size) - 1;
+    if(b.unpadded) while(c.encoded[c.encLen - 1] == '=') --c.encLen;
+
+    // there is always room for encoded data, so inplace runs can share it for both
+    c.stride = (SHLAG_B64_ENCSIZE(size) + 63) / 64 * 64;
+    c.nslots = b.cold && c.stride < POOL_SIZE ? POOL_SIZE / c.stride : 1;
+    c.slots = malloc(c.nslots * sizeof(int64_t));
+    c.in = alloc(c.nslots * c.stride);
+    c.out = b.inplace ? c.in : alloc(c.nslots * c.stride);
+    bool ok = c.slots && c.in && c.out;
+    if(ok) {
+        for(int64_t i = 0; i < c.nslots; ++i) {
+            int64_t j = shlag_pcg32_randrange0(rng, i + 1); // shuffle, so prefetcher won't help
+            c.slots[i] = c.slots[j];
+            c.slots[j] = i;
+            if(b.dec) memcpy(c.in + i * c.stride, c.encoded, c.encLen);
+            else memcpy(c.in + i * c.stride, c.plain, size);
+        }
+        // calibrate iteration count, then do real run
+        int64_t iters = 1;
+        double t;
+        while((t = now(CLOCK_MONOTONIC), run(&c, iters, true), t = now(CLOCK_MONOTONIC) - t) < MIN_TIME / 10) {
+            iters *= 10;
+        }
+        iters = iters * (MIN_TIME / t) + 1;
+        double cpu = now(CLOCK_PROCESS_CPUTIME_ID);
+        t = now(CLOCK_MONOTONIC);
+        run(&c, iters, true);
+        t = now(CLOCK_MONOTONIC) - t;
+        cpu = now(CLOCK_PROCESS_CPUTIME_ID) - cpu;
+        if(b.inplace) { // subtract restoring of input
+            double copyCpu = now(CLOCK_PROCESS_CPUTIME_ID);
+            double copy = now(CLOCK_MONOTONIC);
+            run(&c, iters, false);
+            copy = now(CLOCK_MONOTONIC) - copy;
+            copyCpu = now(CLOCK_PROCESS_CPUTIME_ID) - copyCpu;
+            t = t > copy ? t - copy : 0;
+            cpu = cpu > copyCpu ? cpu - copyCpu : 0;
+        }
+        char name[128];
+        snprintf(name, sizeof(name), "%s/%lld", b.name, (long long)size);
+        printf("%-40s %10.1f ns %10.1f ns %10lld GB/s=%.3f\n", name, t / iters * 1e9,
+                cpu / iters * 1e9, (long long)iters, (double)size * iters / t / 1e9);
+        fflush(stdout);
+    }
+    if(c.out != c.in) free(c.out);
+    free(c.in);
+    free(c.slots);
+    free(c.plain);
+    free(c.encoded);
+    return ok;
+}
+
+int main(int argc, char** argv)
+{
+    int64_t maxSize = (int64_t)1 << 30;
+    const char* filter = "";
+    if(argc > 3 || (argc > 1 && !strcmp(argv[1], "-h"))) {
+        fprintf(stderr, "Usage: %s [max_size [filter]]\n", argv[0]);
+        return 1;
+    }
+    if(argc > 1) maxSize = strtoll(argv[1], NULL, 10);
+    if(argc > 2) filter = argv[2];
+
+    const Bench benches[] = {
+        {"enc_outplace_hot", false, false, false, false},
+        {"enc_inplace_hot", false, true, false, false},
+        {"enc_outplace_cold", false, false, false, true},
+        {"enc_inplace_cold", false, true, false, true},
+        {"dec_outplace_hot", true, false, false, false},
+        {"dec_inplace_hot", true, true, false, false},
+        {"dec_outplace_unpadded_hot", true, false, true, false},
+        {"dec_outplace_cold", true, false, false, true},
+        {"dec_inplace_cold", true, true, false, true},
+    };
+    shlag_pcg32 rng;
+    shlag_pcg32_srand(&rng, 2137, 42);
+
+    // google benchmark prints context to stderr and table to stdout, so gmintbl skips 3 lines
+    fprintf(stderr, "b64bench: max_size %lld, %s kernels\n", (long long)maxSize,
+#if defined(__SSSE3__)
+            "ssse3"
+#elif defined(SHLAG_B64_WIDE)
+            "wide scalar"
+#else
+            "scalar"
+#endif
+            );
+    const char* sep = "--------------------------------------------------------------------------------------\n";
+    printf("%s%-40s %13s %13s %10s %s\n%s", sep, "Benchmark", "Time", "CPU", "Iterations", "UserCounters...", sep);
+    for(unsigned i = 0; i < sizeof(benches)/sizeof(benches[0]); ++i) {
+        if(!strstr(benches[i].name, filter)) continue;
+        for(int64_t size = 16; size <= maxSize; size *= 4) {
+            if(!bench(benches[i], size, &rng)) {
+                fprintf(stderr, "%s/%lld: not enough memory\n", benches[i].name, (long long)size);
+                break;
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,90 @@
+// Performance regression gate for shlag_b64. First run records baseline, later ones
+// fail if any codec got slower than it (by more than tolerance), so e.g:
+// ./b64perf perf.baseline         # on old commit, records
+// ./b64perf perf.baseline         # on new commit, compares
+// SHITEST_BASELINE_UPDATE=1 ./b64perf perf.baseline # accept new numbers
+// Baseline is machine specific, so commit it only if it was measured on machine that runs
+// the gate (e.g. CI runner, meson -Dperf_baseline_dir=dir then makes tests use dir/b64perf.baseline)
+//
+// To build it without buildsystem, run something like:
+// cc -O2 -I. tests/b64perf.c -o bin/b64perf
+#define SHLAG_B64_IMPL
+#include "shlag_b64.h"
+#define SHITEST_IMPL
+#include "shitest.h"
+#include <stdlib.h>
+
+#define TOLERANCE 0.25 // timings on shared machines are noisy, so it isn't tight
+
+typedef struct Ctx {
+    uint8_t* plain;
+    char* encoded;
+    uint8_t* decoded;
+    int64_t n; // plain size
+} Ctx;
+
+static void enc(void* ctx)
+{
+    Ctx* c = (Ctx*)ctx;
+    shlag_b64enc(c->plain, c->n, c->encoded);
+    shi_do_not_optimize(c->encoded[0]);
+}
+
+static void dec(void* ctx)
+{
+    Ctx* c = (Ctx*)ctx;
+    int64_t n = shlag_b64dec(c->encoded, SHLAG_B64_ENCSIZE(c->n) - 1, c->decoded);
+    shi_do_not_optimize(n);
+}
+
+// decodes into its own input, so it has to restore it each time. Copying is measured
+// too, but it is cheap comparing to decoding
+static void dec_inplace(void* ctx)
+{
+    Ctx* c = (Ctx*)ctx;
+    const int64_t len = SHLAG_B64_ENCSIZE(c->n) - 1;
+    memcpy(c->decoded, c->encoded, len);
+    int64_t n = shlag_b64dec((char*)c->decoded, len, c->decoded);
+    shi_do_not_optimize(n);
+}
+
+int main(int argc, char** argv)
+{
+    if(argc != 2) {
+        fprintf(stderr, "Usage: %s baseline_file\n", argv[0]);
+        return 1;
+    }
+    const int64_t sizes[] = {64, 4096, 1 << 20};
+    const int64_t maxSize = sizes[sizeof(sizes)/sizeof(sizes[0]) - 1];
+    Ctx c;
+    c.plain = (uint8_t*)malloc(maxSize);
+    c.encoded = (char*)malloc(SHLAG_B64_ENCSIZE(maxSize));
+    c.decoded = (uint8_t*)malloc(SHLAG_B64_ENCSIZE(maxSize));
+    if(!c.plain || !c.encoded || !c.decoded) {
+        fprintf(stderr, "not enough memory\n");
+        return 1;
+    }
+    for(int64_t i = 0; i < maxSize; ++i) c.plain[i] = i * 2654435761u >> 24;
+
+    shi_baseline_load(argv[1]);
+    for(unsigned i = 0; i < sizeof(sizes)/sizeof(sizes[0]); ++i) {
+        char name[64];
+        c.n = sizes[i];
+        shlag_b64enc(c.plain, c.n, c.encoded);
+        snprintf(name, sizeof(name), "b64enc/%lld", (long long)c.n);
+        shi_bench_check(name, enc, &c, TOLERANCE);
+        snprintf(name, sizeof(name), "b64dec/%lld", (long long)c.n);
+        shi_bench_check(name, dec, &c, TOLERANCE);
+        snprintf(name, sizeof(name), "b64dec_inplace/%lld", (long long)c.n);
+        shi_bench_check(name, dec_inplace, &c, TOLERANCE);
+    }
+    if(!shi_baseline_save(argv[1])) {
+        fprintf(stderr, "can't write %s\n", argv[1]);
+        return 1;
+    }
+    free(c.plain);
+    free(c.encoded);
+    free(c.decoded);
+    fputs(SHI_SEP, stderr);
+    return (shi_test_summary() > 0);
+}
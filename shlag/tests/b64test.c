@@ -55,9 +55,75 @@ TestPair valid_b64_pairs[] = {
 };
 #define ARRSIZE(arr) sizeof(arr)/sizeof(arr[0])
 
-void b64enc_test(TestPair p, bool inplace)
+// encoding under test. Size macros are wrapped in funcs so they can be stored here
+typedef struct Codec
 {
-    shi_test("b64enc(%s)", p.plainStringized);
+    const char* name;
+    void (*enc)(const uint8_t* in, int64_t inSize, char* out);
+    int64_t (*dec)(const char* in, int64_t inLen, uint8_t* out);
+    int64_t (*encsize)(int64_t n);
+    int64_t (*decsize)(int64_t len);
+    // params for naive reference encoder
+    const char* alphabet;
+    int bitsPerChar;
+    int blockChars;
+    bool pad;
+} Codec;
+
+int64_t b64encsize(int64_t n) { return SHLAG_B64_ENCSIZE(n); }
+int64_t b64decsize(int64_t len) { return SHLAG_B64_DECSIZE(len); }
+int64_t b64urlencsize(int64_t n) { return SHLAG_B64URL_ENCSIZE(n); }
+int64_t b32encsize(int64_t n) { return SHLAG_B32_ENCSIZE(n); }
+int64_t b32decsize(int64_t len) { return SHLAG_B32_DECSIZE(len); }
+int64_t b16encsize(int64_t n) { return SHLAG_B16_ENCSIZE(n); }
+int64_t b16decsize(int64_t len) { return SHLAG_B16_DECSIZE(len); }
+
+Codec b64 = {"b64", shlag_b64enc, shlag_b64dec, b64encsize, b64decsize,
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/", 6, 4, true};
+Codec b64url = {"b64url", shlag_b64urlenc, shlag_b64urldec, b64urlencsize, b64decsize,
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_", 6, 4, false};
+Codec b32 = {"b32", shlag_b32enc, shlag_b32dec, b32encsize, b32decsize,
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZ234567", 5, 8, true};
+Codec b16 = {"b16", shlag_b16enc, shlag_b16dec, b16encsize, b16decsize,
+    "0123456789ABCDEF", 4, 2, false};
+Codec b16lower = {"b16lower", shlag_b16enc_lower, shlag_b16dec, b16encsize, b16decsize,
+    "0123456789abcdef", 4, 2, false};
+
+// RFC 4648 examples
+TestPair valid_b64url_pairs[] = {
+    TEST_PAIR("", ""),
+    TEST_PAIR("f", "Zg"),
+    TEST_PAIR("fo", "Zm8"),
+    TEST_PAIR("foobar", "Zm9vYmFy"),
+    TEST_PAIR("\x14\xfb\x9c\x03\xd9\x7e", "FPucA9l-"),
+    TEST_PAIR("\x14\xfb\x9c\x03\xd9", "FPucA9k"),
+    TEST_PAIR("\xfb\xff", "-_8"),
+};
+TestPair valid_b32_pairs[] = {
+    TEST_PAIR("", ""),
+    TEST_PAIR("f", "MY======"),
+    TEST_PAIR("fo", "MZXQ===="),
+    TEST_PAIR("foo", "MZXW6==="),
+    TEST_PAIR("foob", "MZXW6YQ="),
+    TEST_PAIR("fooba", "MZXW6YTB"),
+    TEST_PAIR("foobar", "MZXW6YTBOI======"),
+    TEST_PAIR("\0\0\0\0\0\xff", "AAAAAAAA74======"),
+};
+TestPair valid_b16_pairs[] = {
+    TEST_PAIR("", ""),
+    TEST_PAIR("f", "66"),
+    TEST_PAIR("fo", "666F"),
+    TEST_PAIR("foobar", "666F6F626172"),
+    TEST_PAIR("\0\x9a\xff", "009AFF"),
+};
+TestPair valid_b16lower_pairs[] = {
+    TEST_PAIR("foobar", "666f6f626172"),
+    TEST_PAIR("\0\x9a\xff", "009aff"),
+};
+
+void codec_enc_test(Codec c, TestPair p, bool inplace)
+{
+    shi_test("%senc(%s)", c.name, p.plainStringized);
     // We don't use one big buffer for all tests despite we can, because it
     // could potentially hide OOB bugs from sanitizer
     uint8_t* in;
@@ -68,17 +134,17 @@ void b64enc_test(TestPair p, bool inplace)
     } else {
         in = p.plain;
     }
-    shlag_b64enc(in, p.plainSize, out);
+    c.enc(in, p.plainSize, out);
     shi_assert_streq(p.encoded, out);
     free(out);
     shi_test_end();
 }
 
-void b64enc_testsuite(bool inplace)
+void codec_enc_testsuite(Codec c, TestPair* pairs, unsigned n, bool inplace)
 {
-    fprintf(stderr, "test %s b64enc\n", inplace ? "inplace" : "outplace");
-    for(unsigned i = 0; i<ARRSIZE(valid_b64_pairs); ++i) {
-        b64enc_test(valid_b64_pairs[i], inplace);
+    fprintf(stderr, "test %s %senc\n", inplace ? "inplace" : "outplace", c.name);
+    for(unsigned i = 0; i<n; ++i) {
+        codec_enc_test(c, pairs[i], inplace);
     }
     fputs(SHI_SEP, stderr);
 }
@@ -109,9 +175,9 @@ void* memdup(void* src, size_t n)
     return ptr;
 }
 
-void b64dec_test(TestPair p, bool inplace)
+void codec_dec_test(Codec c, TestPair p, bool inplace)
 {
-    shi_test("b64dec(\"%s\")", p.encoded);
+    shi_test("%sdec(\"%s\")", c.name, p.encoded);
     char* in; uint8_t* out;
     int64_t outsize;
     if(inplace) {
@@ -121,7 +187,7 @@ void b64dec_test(TestPair p, bool inplace)
         in = p.encoded;
         out = malloc(p.plainSize);
     }
-    outsize = shlag_b64dec(in, p.encodedLen, out);
+    outsize = c.dec(in, p.encodedLen, out);
     shi_assert_f(p.plainSize == outsize, 
             "expected_size: %lld, actual_size: %lld", p.plainSize, outsize);
     shi_assert_memeq_f(p.plain, out, p.plainSize, "out != %s", p.plainStringized);
@@ -129,12 +195,12 @@ void b64dec_test(TestPair p, bool inplace)
     free(out);
 }
 
-void b64dec_padded_testsuite(bool inplace)
+void codec_dec_testsuite(Codec c, TestPair* pairs, unsigned n, bool inplace)
 {
-    fprintf(stderr, "test %s b64dec with valid padded data\n", 
-            inplace ? "inplace" : "outplace");
-    for(unsigned i = 0; i<ARRSIZE(valid_b64_pairs); ++i) {
-        b64dec_test(valid_b64_pairs[i], inplace);
+    fprintf(stderr, "test %s %sdec with valid data\n", 
+            inplace ? "inplace" : "outplace", c.name);
+    for(unsigned i = 0; i<n; ++i) {
+        codec_dec_test(c, pairs[i], inplace);
     }
     fputs(SHI_SEP, stderr);
 }
@@ -148,14 +214,14 @@ char* unpad(char* in, int64_t inLen, int64_t* outLen)
     out[*outLen] = '\0';
     return out;
 }
-void b64dec_unpadded_testsuite(bool inplace)
+void codec_dec_unpadded_testsuite(Codec c, TestPair* pairs, unsigned n, bool inplace)
 {
-    fprintf(stderr, "test %s b64dec with valid unpadded data\n",
-            inplace ? "inplace" : "outplace");
-    for(unsigned i = 0; i<ARRSIZE(valid_b64_pairs); ++i) {
-        TestPair p = valid_b64_pairs[i];
+    fprintf(stderr, "test %s %sdec with valid unpadded data\n",
+            inplace ? "inplace" : "outplace", c.name);
+    for(unsigned i = 0; i<n; ++i) {
+        TestPair p = pairs[i];
         p.encoded = unpad(p.encoded, p.encodedLen, &p.encodedLen);
-        b64dec_test(p, inplace);
+        codec_dec_test(c, p, inplace);
         free(p.encoded);
     }
     fputs(SHI_SEP, stderr);
@@ -178,14 +244,18 @@ void b64decsize_testsuite()
     b64decsize_test(3074457345618258602, 2305843009213693951);
     fputs(SHI_SEP, stderr);
 }
-void b64dec_invalid_test(char* in, int inLen)
+void codec_dec_invalid_test(Codec c, char* in, int inLen)
 {
-    shi_test("b64dec(\"%s\")", in);
-    uint8_t* buf = malloc(SHLAG_B64_DECSIZE(inLen));
-    shi_assert_eq(-1, shlag_b64dec(in, inLen, buf), "%lld", int64_t);
+    shi_test("%sdec(\"%s\")", c.name, in);
+    uint8_t* buf = malloc(c.decsize(inLen));
+    shi_assert_eq(-1, c.dec(in, inLen, buf), "%lld", int64_t);
     free(buf);
     shi_test_end();
 }
+void b64dec_invalid_test(char* in, int inLen)
+{
+    codec_dec_invalid_test(b64, in, inLen);
+}
 void b64dec_null_ch_test()
 {
     shi_test("b64_dec(\"a\\0\")");
@@ -212,21 +282,154 @@ void b64dec_invalid_testsuite()
     b64dec_invalid_test("a=a", 3);
     b64dec_invalid_test("=a", 2);
     b64dec_invalid_test("a=", 2);
+    b64dec_invalid_test("Zm9v====", 8);
+    fputs(SHI_SEP, stderr);
+}
+void other_codecs_invalid_testsuite()
+{
+    fprintf(stderr, "test if b64url/b32/b16 dec report errors\n");
+    codec_dec_invalid_test(b64url, "a+", 2); // chars from other base64 variant
+    codec_dec_invalid_test(b64url, "a/", 2);
+    codec_dec_invalid_test(b64url, "a", 1);
+    codec_dec_invalid_test(b64url, "aa=a", 4);
+    codec_dec_invalid_test(b32, "MY======MY======", 16);
+    codec_dec_invalid_test(b32, "my======", 8); // lowercase
+    codec_dec_invalid_test(b32, "MZ1=====", 8); // '1' isn't in alphabet
+    codec_dec_invalid_test(b32, "M", 1); // 1, 3 and 6 chars can't be valid last block
+    codec_dec_invalid_test(b32, "MZX", 3);
+    codec_dec_invalid_test(b32, "MZXW6Y", 6);
+    codec_dec_invalid_test(b32, "========", 8);
+    codec_dec_invalid_test(b16, "6", 1);
+    codec_dec_invalid_test(b16, "666", 3);
+    codec_dec_invalid_test(b16, "6G", 2);
+    codec_dec_invalid_test(b16, "66==", 4); // there is no padding in base16
+    fputs(SHI_SEP, stderr);
+}
+
+// Naive bit by bit encoder, used as reference for longer inputs (which go through
+// vectorized kernels, if they are enabled). @out have to be big enough
+void naive_enc(Codec c, const uint8_t* in, int64_t n, char* out)
+{
+    int64_t len = 0;
+    for(int64_t bit = 0; bit < n*8; bit += c.bitsPerChar) {
+        unsigned v = 0;
+        for(int k = 0; k < c.bitsPerChar; ++k) {
+            int64_t b = bit + k;
+            v = (v << 1) | (b < n*8 ? (in[b/8] >> (7 - b%8)) & 1 : 0);
+        }
+        out[len++] = c.alphabet[v];
+    }
+    while(c.pad && len % c.blockChars) out[len++] = '=';
+    out[len] = '\0';
+}
+void codec_long_test(Codec c, const uint8_t* data, int64_t n, bool inplace)
+{
+    shi_test("%s roundtrip of %lld bytes", c.name, n);
+    int64_t encsize = c.encsize(n);
+    char* expected = malloc(encsize);
+    char* out = malloc(encsize);
+    naive_enc(c, data, n, expected);
+    memcpy(out, data, n);
+    c.enc(inplace ? (uint8_t*)out : data, n, out);
+    shi_assert_streq(expected, out);
+
+    uint8_t* decoded = inplace ? (uint8_t*)out : malloc(c.decsize(encsize - 1));
+    shi_assert_eq(n, c.dec(out, encsize - 1, decoded), "%lld", int64_t);
+    shi_assert_memeq(data, decoded, n);
+
+    // invalid char anywhere must be caught, no matter which kernel sees it
+    for(int64_t k = 0; k < encsize - 1; k += 7) {
+        c.enc(data, n, expected);
+        expected[k] = '*';
+        shi_assert_f(c.dec(expected, encsize - 1, (uint8_t*)expected) == -1,
+                "'*' at %lld not reported", k);
+    }
+    if(!inplace) free(decoded);
+    free(expected);
+    free(out);
+    shi_test_end();
+}
+void codec_long_testsuite(Codec c, bool inplace)
+{
+    fprintf(stderr, "test %s %s with longer pseudorandom data\n", inplace ? "inplace" : "outplace", c.name);
+    uint8_t data[300];
+    uint32_t x = 2137;
+    for(unsigned i = 0; i < ARRSIZE(data); ++i) {
+        x = x * 1103515245 + 12345;
+        data[i] = x >> 24;
+    }
+    for(int64_t n = 0; n <= 100; ++n) codec_long_test(c, data, n, inplace);
+    codec_long_test(c, data, ARRSIZE(data), inplace);
     fputs(SHI_SEP, stderr);
 }
+#ifdef SHITEST_ALLOC
+// encoders and decoders (especially inplace ones) are meant for hot paths, so they
+// must never allocate
+void codec_noalloc_test(Codec c, bool inplace)
+{
+    shi_test("%s %s enc/dec don't allocate", inplace ? "inplace" : "outplace", c.name);
+    uint8_t data[300];
+    for(unsigned i = 0; i < ARRSIZE(data); ++i) data[i] = i * 37;
+    char* enc = malloc(c.encsize(ARRSIZE(data)));
+    uint8_t* dec = inplace ? (uint8_t*)enc : malloc(ARRSIZE(data));
+    memcpy(enc, data, ARRSIZE(data));
+    shi_assert_no_alloc_begin();
+    c.enc(inplace ? (uint8_t*)enc : data, ARRSIZE(data), enc);
+    int64_t n = c.dec(enc, c.encsize(ARRSIZE(data)) - 1, dec);
+    shi_assert_no_alloc_end();
+    shi_assert_eq((int64_t)ARRSIZE(data), n, "%lld", int64_t);
+    shi_assert_max_allocs(inplace ? 1 : 2);
+    if(!inplace) free(dec);
+    free(enc);
+    shi_test_end();
+}
+void codec_noalloc_testsuite(Codec* codecs, unsigned n)
+{
+    fprintf(stderr, "test that codecs don't allocate\n");
+    for(unsigned i = 0; i < n; ++i) {
+        codec_noalloc_test(codecs[i], false);
+        codec_noalloc_test(codecs[i], true);
+    }
+    fputs(SHI_SEP, stderr);
+}
+#endif
 int main()
 {
     enum {OUTPLACE = 0, INPLACE = 1};
-    b64enc_testsuite(OUTPLACE);
-    b64enc_testsuite(INPLACE);
+    codec_enc_testsuite(b64, valid_b64_pairs, ARRSIZE(valid_b64_pairs), OUTPLACE);
+    codec_enc_testsuite(b64, valid_b64_pairs, ARRSIZE(valid_b64_pairs), INPLACE);
     b64encsize_testsuite();
 
-    b64dec_padded_testsuite(OUTPLACE);
-    b64dec_padded_testsuite(INPLACE);
-    b64dec_unpadded_testsuite(OUTPLACE);
-    b64dec_unpadded_testsuite(INPLACE);
+    codec_dec_testsuite(b64, valid_b64_pairs, ARRSIZE(valid_b64_pairs), OUTPLACE);
+    codec_dec_testsuite(b64, valid_b64_pairs, ARRSIZE(valid_b64_pairs), INPLACE);
+    codec_dec_unpadded_testsuite(b64, valid_b64_pairs, ARRSIZE(valid_b64_pairs), OUTPLACE);
+    codec_dec_unpadded_testsuite(b64, valid_b64_pairs, ARRSIZE(valid_b64_pairs), INPLACE);
 
     b64decsize_testsuite();
     b64dec_invalid_testsuite();
+
+    struct { Codec c; TestPair* pairs; unsigned n; } others[] = {
+        {b64url, valid_b64url_pairs, ARRSIZE(valid_b64url_pairs)},
+        {b32, valid_b32_pairs, ARRSIZE(valid_b32_pairs)},
+        {b16, valid_b16_pairs, ARRSIZE(valid_b16_pairs)},
+        {b16lower, valid_b16lower_pairs, ARRSIZE(valid_b16lower_pairs)},
+    };
+    for(unsigned i = 0; i < ARRSIZE(others); ++i) {
+        for(int inplace = 0; inplace <= 1; ++inplace) {
+            codec_enc_testsuite(others[i].c, others[i].pairs, others[i].n, inplace);
+            codec_dec_testsuite(others[i].c, others[i].pairs, others[i].n, inplace);
+        }
+        codec_dec_unpadded_testsuite(others[i].c, others[i].pairs, others[i].n, OUTPLACE);
+    }
+    other_codecs_invalid_testsuite();
+
+    Codec all[] = {b64, b64url, b32, b16, b16lower};
+    for(unsigned i = 0; i < ARRSIZE(all); ++i) {
+        codec_long_testsuite(all[i], OUTPLACE);
+        codec_long_testsuite(all[i], INPLACE);
+    }
+#ifdef SHITEST_ALLOC
+    codec_noalloc_testsuite(all, ARRSIZE(all));
+#endif
     return (shi_test_summary() > 0);
 }
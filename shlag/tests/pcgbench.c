@@ -0,0 +1,231 @@
+// Benchmark for shlag_pcg. Output mimics google benchmark's console output, so you can
+// pipe it into `scripts/gmintbl`, e.g:
+// ./pcgbench | gmintbl gcc > out
+//
+// Usage: pcgbench [max_size [filter]]
+// max_size (default 10^8) is biggest array that gets shuffled, filter is substring of
+// benchmark names to run. Times are per element
+//
+// To build it without buildsystem, run something like:
+// cc -O2 -I. tests/pcgbench.c -o bin/pcgbench -lm
+#define SHLAG_PCG_IMPL
+#define SHLAG_PCG_NORMAL
+#include "shlag_pcg.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define MIN_TIME 0.2 // seconds spent in each benchmark (more or less)
+
+typedef struct Ctx {
+    shlag_pcg32 rng;
+    shlag_pcg64 rng64;
+    uint32_t* arr; // big enough for n doubles
+    size_t n;
+    shlag_pcg_ziggurat zig;
+} Ctx;
+
+static volatile uint32_t sink; // keeps results from being optimized away
+
+// Fisher-Yates with one randrange0() per swap, i.e what you would write by hand
+static void naive_shuffle(Ctx* c)
+{
+    for(size_t i = c->n; i > 1; --i) {
+        uint32_t j = shlag_pcg32_randrange0(&c->rng, i);
+        uint32_t tmp = c->arr[i-1];
+        c->arr[i-1] = c->arr[j];
+        c->arr[j] = tmp;
+    }
+}
+
+static void batched_shuffle(Ctx* c)
+{
+    shlag_pcg32_shuffle(&c->rng, c->arr, c->n, sizeof(uint32_t));
+}
+
+// half of generator calls of pcg32 one (64bit number is one call)
+static void pcg64_batched_shuffle(Ctx* c)
+{
+    shlag_pcg64_shuffle(&c->rng64, c->arr, c->n, sizeof(uint32_t));
+}
+
+// sample 1% of array
+static void naive_sample(Ctx* c)
+{
+    for(size_t i = 0; i < c->n / 100; ++i) {
+        uint32_t j = i + shlag_pcg32_randrange0(&c->rng, c->n - i);
+        uint32_t tmp = c->arr[i];
+        c->arr[i] = c->arr[j];
+        c->arr[j] = tmp;
+    }
+}
+
+static void batched_sample(Ctx* c)
+{
+    shlag_pcg32_sample(&c->rng, c->arr, c->n, sizeof(uint32_t), c->n / 100);
+}
+
+static void pcg64_batched_sample(Ctx* c)
+{
+    shlag_pcg64_sample(&c->rng64, c->arr, c->n, sizeof(uint32_t), c->n / 100);
+}
+
+// keep 1% of stream
+static void reservoir(Ctx* c)
+{
+    shlag_pcg32_reservoir res = {0, c->n / 100 + 1};
+    for(size_t i = 0; i < c->n; ++i) {
+        int64_t slot = shlag_pcg32_reservoir_add(&c->rng, &res);
+        if(slot >= 0) c->arr[slot] = i;
+    }
+}
+
+static void rand_loop(Ctx* c)
+{
+    uint32_t acc = 0;
+    for(size_t i = 0; i < c->n; ++i) acc += shlag_pcg32_rand(&c->rng);
+    sink = acc;
+}
+
+// 64bit numbers from two pcg32 calls vs one pcg64 call
+static void rand64_stitched(Ctx* c)
+{
+    uint64_t acc = 0;
+    for(size_t i = 0; i < c->n; ++i) acc += (uint64_t)shlag_pcg32_rand(&c->rng) << 32 | shlag_pcg32_rand(&c->rng);
+    sink = acc;
+}
+
+static void pcg64_rand_loop(Ctx* c)
+{
+    uint64_t acc = 0;
+    for(size_t i = 0; i < c->n; ++i) acc += shlag_pcg64_rand(&c->rng64);
+    sink = acc;
+}
+
+static void pcg64_randrange0_loop(Ctx* c)
+{
+    uint64_t acc = 0;
+    for(size_t i = 0; i < c->n; ++i) acc += shlag_pcg64_randrange0(&c->rng64, 6000000000000000000ULL);
+    sink = acc;
+}
+
+static void fill(Ctx* c)
+{
+    shlag_pcg32_fill(&c->rng, c->arr, c->n);
+}
+
+static void randf_loop(Ctx* c)
+{
+    float* buf = (float*)c->arr;
+    for(size_t i = 0; i < c->n; ++i) buf[i] = shlag_pcg32_randf(&c->rng);
+}
+
+// what callers did before randf()
+static void randf_division(Ctx* c)
+{
+    float* buf = (float*)c->arr;
+    for(size_t i = 0; i < c->n; ++i) buf[i] = shlag_pcg32_rand(&c->rng) / 4294967296.0;
+}
+
+static void fillf(Ctx* c)
+{
+    shlag_pcg32_fillf(&c->rng, (float*)c->arr, c->n);
+}
+
+static void filld(Ctx* c)
+{
+    shlag_pcg32_filld(&c->rng, (double*)c->arr, c->n);
+}
+
+static void normal(Ctx* c)
+{
+    double* buf = (double*)c->arr;
+    for(size_t i = 0; i < c->n; ++i) buf[i] = shlag_pcg32_normal(&c->rng, &c->zig);
+}
+
+static double now(clockid_t clk)
+{
+    struct timespec t;
+    clock_gettime(clk, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static double run(void (*fn)(Ctx*), Ctx* c, int64_t iters)
+{
+    double t = now(CLOCK_MONOTONIC);
+    for(int64_t i = 0; i < iters; ++i) fn(c);
+    return now(CLOCK_MONOTONIC) - t;
+}
+
+static void bench(const char* name, void (*fn)(Ctx*), Ctx* c)
+{
+    // calibrate iteration count, then do real run
+    int64_t iters = 1;
+    double t;
+    while((t = run(fn, c, iters)) < MIN_TIME / 10) iters *= 10;
+    iters = iters * (MIN_TIME / t) + 1;
+    double cpu = now(CLOCK_PROCESS_CPUTIME_ID);
+    t = run(fn, c, iters);
+    cpu = now(CLOCK_PROCESS_CPUTIME_ID) - cpu;
+    char fullname[128];
+    snprintf(fullname, sizeof(fullname), "%s/%zu", name, c->n);
+    const double elems = (double)iters * c->n;
+    printf("%-40s %10.3f ns %10.3f ns %10lld\n", fullname, t / elems * 1e9, cpu / elems * 1e9, (long long)iters);
+    fflush(stdout);
+    sink = c->arr[0];
+    for(size_t i = 0; i < c->n; ++i) c->arr[i] = i; // other benchmarks could leave garbage
+}
+
+int main(int argc, char** argv)
+{
+    size_t maxSize = 100000000;
+    const char* filter = "";
+    if(argc > 3 || (argc > 1 && !strcmp(argv[1], "-h"))) {
+        fprintf(stderr, "Usage: %s [max_size [filter]]\n", argv[0]);
+        return 1;
+    }
+    if(argc > 1) maxSize = strtoull(argv[1], NULL, 10);
+    if(argc > 2) filter = argv[2];
+
+    const struct { const char* name; void (*fn)(Ctx*); } benches[] = {
+        {"rand_loop", rand_loop},
+        {"fill", fill},
+        {"rand64_stitched", rand64_stitched},
+        {"pcg64_rand_loop", pcg64_rand_loop},
+        {"pcg64_randrange0_loop", pcg64_randrange0_loop},
+        {"randf_loop", randf_loop},
+        {"randf_division", randf_division},
+        {"fillf", fillf},
+        {"filld", filld},
+        {"normal", normal},
+        {"naive_shuffle", naive_shuffle},
+        {"batched_shuffle", batched_shuffle},
+        {"pcg64_batched_shuffle", pcg64_batched_shuffle},
+        {"naive_sample1%", naive_sample},
+        {"batched_sample1%", batched_sample},
+        {"pcg64_batched_sample1%", pcg64_batched_sample},
+        {"reservoir1%", reservoir},
+    };
+    Ctx c;
+    shlag_pcg32_srand(&c.rng, 2137, 42);
+    shlag_pcg64_srand(&c.rng64, 2137, 42);
+    shlag_pcg_ziggurat_init(&c.zig);
+    c.arr = malloc(maxSize * sizeof(double) + 1);
+    if(!c.arr) {
+        fprintf(stderr, "not enough memory\n");
+        return 1;
+    }
+    for(size_t i = 0; i < maxSize; ++i) c.arr[i] = i;
+
+    // google benchmark prints context to stderr and table to stdout, so gmintbl skips 3 lines
+    fprintf(stderr, "pcgbench: max_size %zu\n", maxSize);
+    const char* sep = "----------------------------------------------------------------------------\n";
+    printf("%s%-40s %13s %13s %10s\n%s", sep, "Benchmark", "Time", "CPU", "Iterations", sep);
+    for(unsigned i = 0; i < sizeof(benches)/sizeof(benches[0]); ++i) {
+        if(!strstr(benches[i].name, filter)) continue;
+        for(c.n = 1000; c.n <= maxSize; c.n *= 10) bench(benches[i].name, benches[i].fn, &c);
+    }
+    free(c.arr);
+    return 0;
+}
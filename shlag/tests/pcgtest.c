@@ -0,0 +1,573 @@
+// Compile it with something like:
+// cc -I. tests/pcgtest.c -o bin/pcgtest -lm
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <math.h>
+#define SHLAG_PCG_IMPL
+#define SHLAG_PCG_NORMAL
+#include "shlag_pcg.h"
+#define SHITEST_IMPL
+#include "shitest.h"
+
+#define ARRSIZE(arr) (sizeof(arr)/sizeof(arr[0]))
+
+// generate n numbers and discard them, i.e. what advance() should do faster
+void discard(shlag_pcg32* rng, uint64_t n)
+{
+    while(n--) shlag_pcg32_rand(rng);
+}
+
+void rand_known_answer_test()
+{
+    fprintf(stderr, "test if rand() matches reference pcg32 (pcg32-demo, seed 42 54)\n");
+    const uint32_t expected[] = {0xa15c02b7, 0x7b47f409, 0xba1d3330, 0x83d2f293, 0xbfa4784b, 0xcbed606e};
+    shlag_pcg32 rng;
+    shlag_pcg32_srand(&rng, 42, 54);
+    for(unsigned i = 0; i < ARRSIZE(expected); ++i) {
+        shi_test("rand() #%u", i);
+        shi_assert_eq(expected[i], shlag_pcg32_rand(&rng), "0x%08x", uint32_t);
+        shi_test_end();
+    }
+    fputs(SHI_SEP, stderr);
+}
+
+void fill_testsuite()
+{
+    fprintf(stderr, "test if fill() gives same numbers as rand()\n");
+    const size_t sizes[] = {0, 1, 7, 1000};
+    uint32_t buf[1001];
+    for(unsigned i = 0; i < ARRSIZE(sizes); ++i) {
+        shi_test("fill(%zu)", sizes[i]);
+        shlag_pcg32 a, b;
+        shlag_pcg32_srand(&a, 42, i);
+        b = a;
+        buf[sizes[i]] = 2137; // canary
+        shlag_pcg32_fill(&a, buf, sizes[i]);
+        for(size_t j = 0; j < sizes[i]; ++j) {
+            uint32_t expected = shlag_pcg32_rand(&b);
+            shi_assert_f(expected == buf[j], "buf[%zu]: expected: %u, actual: %u", j, expected, buf[j]);
+        }
+        shi_assert_eq(2137, buf[sizes[i]], "%u", uint32_t);
+        shi_assert_eq(b.state, a.state, "%llu", unsigned long long);
+        shi_test_end();
+    }
+    fputs(SHI_SEP, stderr);
+}
+
+// check that bounded sampler and fillrange() consume and return exactly the same
+// numbers as randrange()
+void bounded_test(uint32_t begin, uint32_t end)
+{
+    enum {N = 2000};
+    shi_test("bounded [%u, %u)", begin, end);
+    shlag_pcg32 a, b, c;
+    shlag_pcg32_srand(&a, begin, end);
+    b = c = a;
+    uint32_t buf[N];
+    shlag_pcg32_fillrange(&c, buf, N, begin, end);
+    const shlag_pcg32_bounded bounded = shlag_pcg32_bounded_init(begin, end);
+    for(unsigned i = 0; i < N; ++i) {
+        uint32_t expected = shlag_pcg32_randrange(&a, begin, end);
+        uint32_t actual = shlag_pcg32_bounded_rand(&b, &bounded);
+        shi_assert_f(expected == actual, "draw %u: expected: %u, actual: %u", i, expected, actual);
+        shi_assert_f(expected == buf[i], "buf[%u]: expected: %u, actual: %u", i, expected, buf[i]);
+    }
+    shi_assert_eq(a.state, b.state, "%llu", unsigned long long);
+    shi_assert_eq(a.state, c.state, "%llu", unsigned long long);
+    shi_test_end();
+}
+
+void bounded_testsuite()
+{
+    fprintf(stderr, "test if bounded sampler and fillrange() match randrange()\n");
+    bounded_test(0, 0);
+    bounded_test(5, 5);
+    bounded_test(0, 1);
+    bounded_test(0, 6);
+    bounded_test(100, 1100);
+    bounded_test(0, 0x80000001); // ~half of numbers get rejected
+    bounded_test(0xC0000000, 0xFFFFFFFF);
+    bounded_test(0, 0xFFFFFFFF);
+    bounded_test(1, 0); // wraps around, range is 2^32-1
+    fputs(SHI_SEP, stderr);
+}
+
+void float_testsuite()
+{
+    fprintf(stderr, "test float generation\n");
+    enum {N = 100000};
+    shlag_pcg32 rng, ref;
+    shlag_pcg32_srand(&rng, 5, 5);
+
+    shi_test("randf() maps raw bits to multiples of 2^-24");
+    ref = rng;
+    for(unsigned i = 0; i < 100; ++i) {
+        uint32_t r = shlag_pcg32_rand(&ref);
+        shi_assert_eq((r >> 8) / 16777216.0f, shlag_pcg32_randf(&rng), "%a", float);
+    }
+    shi_assert_eq(0.0f, shlag_pcg_tofloat(0), "%a", float);
+    shi_assert_eq(1.0f - 1.0f / 16777216, shlag_pcg_tofloat(UINT32_MAX), "%a", float);
+    shi_test_end();
+
+    shi_test("randd() maps raw bits to multiples of 2^-53");
+    ref = rng;
+    for(unsigned i = 0; i < 100; ++i) {
+        uint64_t r = (uint64_t)shlag_pcg32_rand(&ref) << 32;
+        r |= shlag_pcg32_rand(&ref);
+        shi_assert_eq((r >> 11) / 9007199254740992.0, shlag_pcg32_randd(&rng), "%a", double);
+    }
+    shi_assert_eq(1.0 - 1.0 / 9007199254740992.0, shlag_pcg_todouble(UINT64_MAX), "%a", double);
+    shi_test_end();
+
+    shi_test("randf_range() and randd_range() stay in range, mean is in the middle");
+    double sumf = 0, sumd = 0;
+    for(unsigned i = 0; i < N; ++i) {
+        float f = shlag_pcg32_randf_range(&rng, -3.0f, 5.0f);
+        double d = shlag_pcg32_randd_range(&rng, 10.0, 11.0);
+        shi_assert_f(f >= -3.0f && f < 5.0f, "%f out of range", f);
+        shi_assert_f(d >= 10.0 && d < 11.0, "%f out of range", d);
+        sumf += f;
+        sumd += d;
+    }
+    // stddev of mean is 8/sqrt(12*N) ~ 0.007 and 0.0009
+    shi_assert_f(fabs(sumf / N - 1.0) < 0.04, "mean: %f", sumf / N);
+    shi_assert_f(fabs(sumd / N - 10.5) < 0.005, "mean: %f", sumd / N);
+    shi_test_end();
+
+    static float bufF[1001];
+    static double bufD[1001];
+    const size_t sizes[] = {0, 1, 255, 256, 257, 1000};
+    for(unsigned i = 0; i < ARRSIZE(sizes); ++i) {
+        shi_test("fillf(%zu) and filld(%zu) match randf() and randd()", sizes[i], sizes[i]);
+        ref = rng;
+        shlag_pcg32_fillf(&rng, bufF, sizes[i]);
+        shlag_pcg32_filld(&rng, bufD, sizes[i]);
+        for(size_t j = 0; j < sizes[i]; ++j) {
+            float f = shlag_pcg32_randf(&ref);
+            shi_assert_f(f == bufF[j], "bufF[%zu]: expected: %a, actual %a", j, f, bufF[j]);
+        }
+        for(size_t j = 0; j < sizes[i]; ++j) {
+            double d = shlag_pcg32_randd(&ref);
+            shi_assert_f(d == bufD[j], "bufD[%zu]: expected: %a, actual %a", j, d, bufD[j]);
+        }
+        shi_assert_eq(ref.state, rng.state, "%llu", unsigned long long);
+        shi_test_end();
+    }
+    fputs(SHI_SEP, stderr);
+}
+
+void normal_testsuite()
+{
+    fprintf(stderr, "test normal distribution sampler\n");
+    enum {N = 1000000};
+    shlag_pcg_ziggurat zig;
+    shlag_pcg_ziggurat_init(&zig);
+    shlag_pcg32 rng;
+    shlag_pcg32_srand(&rng, 9, 9);
+    double sum = 0, sum2 = 0;
+    unsigned beyond1 = 0, beyond3 = 0, tail = 0;
+    for(unsigned i = 0; i < N; ++i) {
+        double x = shlag_pcg32_normal(&rng, &zig);
+        sum += x;
+        sum2 += x * x;
+        beyond1 += fabs(x) > 1;
+        beyond3 += fabs(x) > 3;
+        tail += fabs(x) > SHLAG_PCG_ZIG_R;
+    }
+    double mean = sum / N, var = sum2 / N - mean * mean;
+    shi_test("mean ~ 0, variance ~ 1");
+    shi_assert_f(fabs(mean) < 0.005, "mean: %f", mean); // stddev of mean is 0.001
+    shi_assert_f(fabs(var - 1) < 0.01, "variance: %f", var);
+    shi_test_end();
+    // P(|x| > 1) = 0.3173, P(|x| > 3) = 0.0027, P(|x| > R) = 0.000576
+    shi_test("P(|x| > 1), P(|x| > 3) and tail probabilities");
+    shi_assert_f(fabs(beyond1 / (double)N - 0.3173) < 0.003, "P(|x| > 1) = %f", beyond1 / (double)N);
+    shi_assert_f(fabs(beyond3 / (double)N - 0.0027) < 0.0003, "P(|x| > 3) = %f", beyond3 / (double)N);
+    shi_assert_f(fabs(tail / (double)N - 0.000576) < 0.00015, "P(|x| > R) = %f", tail / (double)N);
+    shi_test_end();
+    fputs(SHI_SEP, stderr);
+}
+
+int cmp_u32(const void* a, const void* b)
+{
+    uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+    return (x > y) - (x < y);
+}
+
+// shuffle array of n elements with given size (each one holds its index in first 4
+// bytes, rest is filled with its low byte) and check that it is still same multiset
+void shuffle_permutation_test(size_t n, size_t size, bool use64)
+{
+    shi_test("%s_shuffle(n=%zu, size=%zu) gives permutation", use64 ? "pcg64" : "pcg32", n, size);
+    shlag_pcg32 rng;
+    shlag_pcg32_srand(&rng, n, size);
+    shlag_pcg64 rng64;
+    shlag_pcg64_srand(&rng64, n, size);
+    unsigned char* arr = malloc(n * size + 1);
+    for(size_t i = 0; i < n; ++i) {
+        memset(arr + i * size, (unsigned char)i, size);
+        if(size >= 4) memcpy(arr + i * size, &(uint32_t){i}, 4);
+    }
+    if(use64) shlag_pcg64_shuffle(&rng64, arr, n, size);
+    else shlag_pcg32_shuffle(&rng, arr, n, size);
+    bool moved = n < 10; // for big arrays chance that nothing moved is negligible
+    uint32_t* keys = malloc(n * sizeof(uint32_t) + 1);
+    for(size_t i = 0; i < n; ++i) {
+        unsigned char* e = arr + i * size;
+        uint32_t key = e[0];
+        if(size >= 4) memcpy(&key, e, 4);
+        for(size_t b = size >= 4 ? 4 : 0; b < size; ++b) {
+            shi_assert_f(e[b] == (unsigned char)key, "element %zu got torn", i);
+        }
+        keys[i] = key;
+        moved |= size >= 4 && key != i;
+    }
+    qsort(keys, n, sizeof(uint32_t), cmp_u32);
+    for(size_t i = 0; i < n && size >= 4; ++i) {
+        shi_assert_f(keys[i] == i, "%zu is missing after shuffle", i);
+    }
+    shi_assert_f(moved || size < 4, "nothing moved");
+    shi_test_end();
+    free(keys);
+    free(arr);
+}
+
+// shuffle {0,1,2,3} many times, each of 24 permutations should come up ~equally often
+void shuffle_uniformity_test()
+{
+    enum {N = 4, PERMS = 24, TRIALS = PERMS * 2000};
+    shi_test("shuffle() uniformity");
+    shlag_pcg32 rng;
+    shlag_pcg32_srand(&rng, 1, 1);
+    unsigned counts[N*N*N*N] = {0};
+    for(unsigned t = 0; t < TRIALS; ++t) {
+        uint8_t arr[N] = {0, 1, 2, 3};
+        shlag_pcg32_shuffle(&rng, arr, N, 1);
+        counts[arr[0]*64 + arr[1]*16 + arr[2]*4 + arr[3]]++;
+    }
+    unsigned seen = 0;
+    double chi2 = 0;
+    for(unsigned i = 0; i < N*N*N*N; ++i) {
+        if(!counts[i]) continue;
+        ++seen;
+        double d = (double)counts[i] - TRIALS / PERMS;
+        chi2 += d * d / (TRIALS / PERMS);
+    }
+    shi_assert_eq(PERMS, seen, "%u", unsigned);
+    // 23 degrees of freedom, p=0.001 critical value is 49.7
+    shi_assert_f(chi2 < 49.7, "chi2 = %f, distribution is likely biased", chi2);
+    shi_test_end();
+}
+
+// sample() draws several indices from one 64bit number, with batch size picked by n (2
+// above 2^19, 3 above 2^14, 4 above 2^11, 5 above 2^9, 6 below). First two picks come from
+// the same batch, so check their joint distribution: values are put into 10 bins, and each
+// of 100 (bin, bin) pairs should come up as often as for truly random distinct pair
+void sample_batch_uniformity_test(size_t n, bool use64)
+{
+    enum {B = 10, K = 12, TRIALS = 20000};
+    shi_test("%s_sample(%d of %zu) picks are uniform and independent", use64 ? "pcg64" : "pcg32", K, n);
+    shlag_pcg32 rng;
+    shlag_pcg32_srand(&rng, n, 2137);
+    shlag_pcg64 rng64;
+    shlag_pcg64_srand(&rng64, n, 2137);
+    uint32_t* arr = malloc(n * sizeof(uint32_t));
+    for(size_t i = 0; i < n; ++i) arr[i] = i;
+    unsigned counts[B][B] = {{0}};
+    for(unsigned t = 0; t < TRIALS; ++t) {
+        if(use64) shlag_pcg64_sample(&rng64, arr, n, sizeof(uint32_t), K);
+        else shlag_pcg32_sample(&rng, arr, n, sizeof(uint32_t), K);
+        counts[arr[0] * B / n][arr[1] * B / n]++;
+        // restore identity, so values are picked indices. Only first K slots and picked
+        // ones were touched, so it's cheap
+        uint32_t picked[K];
+        memcpy(picked, arr, sizeof(picked));
+        for(unsigned i = 0; i < K; ++i) arr[picked[i]] = picked[i];
+        for(unsigned i = 0; i < K; ++i) arr[i] = i;
+    }
+    size_t binSize[B] = {0};
+    for(size_t v = 0; v < n; ++v) binSize[v * B / n]++;
+    double chi2 = 0;
+    for(unsigned a = 0; a < B; ++a) {
+        for(unsigned b = 0; b < B; ++b) {
+            double expected = (double)TRIALS * binSize[a] * (binSize[b] - (a == b)) / ((double)n * (n - 1));
+            double d = counts[a][b] - expected;
+            chi2 += d * d / expected;
+        }
+    }
+    // 99 degrees of freedom, p=0.001 critical value is 148.2
+    shi_assert_f(chi2 < 148.2, "chi2 = %f, distribution is likely biased", chi2);
+    shi_test_end();
+    free(arr);
+}
+
+void sample_test(size_t n, size_t k)
+{
+    shi_test("sample(%zu of %zu)", k, n);
+    shlag_pcg32 rng;
+    shlag_pcg32_srand(&rng, n, k);
+    uint32_t* arr = malloc(n * sizeof(uint32_t) + 1);
+    for(size_t i = 0; i < n; ++i) arr[i] = i;
+    shlag_pcg32_sample(&rng, arr, n, sizeof(uint32_t), k);
+    qsort(arr, n, sizeof(uint32_t), cmp_u32); // whole array still has to be permutation
+    for(size_t i = 0; i < n; ++i) shi_assert_f(arr[i] == i, "%zu is missing", i);
+    shi_test_end();
+    free(arr);
+}
+
+void sample_testsuite()
+{
+    fprintf(stderr, "test shuffle() and sample()\n");
+    const size_t sizes[] = {0, 1, 2, 3, 10, 600, 5000, 100000};
+    const size_t elemSizes[] = {1, 3, 4, 8, 100};
+    for(unsigned i = 0; i < ARRSIZE(sizes); ++i) {
+        for(unsigned j = 0; j < ARRSIZE(elemSizes); ++j) {
+            shuffle_permutation_test(sizes[i], elemSizes[j], false);
+            shuffle_permutation_test(sizes[i], elemSizes[j], true);
+        }
+    }
+    shuffle_uniformity_test();
+    sample_test(0, 0);
+    sample_test(10, 0);
+    sample_test(10, 3);
+    sample_test(10, 10);
+    sample_test(10, 20);
+    sample_test(100000, 1000);
+    const size_t batchSizes[] = {100, 600, 3000, 20000, 600000}; // one for each batch size
+    for(unsigned i = 0; i < ARRSIZE(batchSizes); ++i) {
+        sample_batch_uniformity_test(batchSizes[i], false);
+        sample_batch_uniformity_test(batchSizes[i], true);
+    }
+
+    shi_test("sample() chooses each element equally often");
+    enum {N = 10, K = 3, TRIALS = 30000};
+    shlag_pcg32 rng;
+    shlag_pcg32_srand(&rng, 7, 7);
+    unsigned counts[N] = {0};
+    for(unsigned t = 0; t < TRIALS; ++t) {
+        uint32_t arr[N] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9};
+        shlag_pcg32_sample(&rng, arr, N, sizeof(uint32_t), K);
+        for(unsigned i = 0; i < K; ++i) counts[arr[i]]++;
+    }
+    for(unsigned i = 0; i < N; ++i) { // expected 9000, stddev ~80
+        shi_assert_f(counts[i] > 8600 && counts[i] < 9400, "%u chosen %u times", i, counts[i]);
+    }
+    shi_test_end();
+    fputs(SHI_SEP, stderr);
+}
+
+void reservoir_testsuite()
+{
+    fprintf(stderr, "test reservoir sampling\n");
+    enum {N = 10, K = 3, TRIALS = 30000};
+    shlag_pcg32 rng;
+    shlag_pcg32_srand(&rng, 3, 3);
+    shi_test("first k items fill reservoir");
+    shlag_pcg32_reservoir res = {0, K};
+    for(unsigned i = 0; i < K; ++i) shi_assert_eq(i, shlag_pcg32_reservoir_add(&rng, &res), "%lld", long long);
+    shi_test_end();
+
+    shi_test("each item ends in reservoir equally often");
+    unsigned counts[N] = {0};
+    for(unsigned t = 0; t < TRIALS; ++t) {
+        uint32_t reservoir[K];
+        shlag_pcg32_reservoir res = {0, K};
+        for(uint32_t item = 0; item < N; ++item) {
+            int64_t slot = shlag_pcg32_reservoir_add(&rng, &res);
+            shi_assert_f(slot >= -1 && slot < K, "slot %lld out of range", (long long)slot);
+            if(slot >= 0) reservoir[slot] = item;
+        }
+        for(unsigned i = 0; i < K; ++i) counts[reservoir[i]]++;
+    }
+    for(unsigned i = 0; i < N; ++i) { // expected 9000, stddev ~80
+        shi_assert_f(counts[i] > 8600 && counts[i] < 9400, "%u kept %u times", i, counts[i]);
+    }
+    shi_test_end();
+    fputs(SHI_SEP, stderr);
+}
+
+void advance_test(uint64_t delta)
+{
+    shi_test("advance(%llu)", (unsigned long long)delta);
+    shlag_pcg32 a, b;
+    shlag_pcg32_srand(&a, 2137, delta);
+    b = a;
+    discard(&a, delta);
+    shlag_pcg32_advance(&b, delta);
+    shi_assert_eq(a.state, b.state, "%llu", unsigned long long);
+    shi_assert_eq(shlag_pcg32_rand(&a), shlag_pcg32_rand(&b), "%u", uint32_t);
+    shlag_pcg32_advance(&b, -(delta + 1)); // go back, to where we started
+    shlag_pcg32_srand(&a, 2137, delta);
+    shi_assert_eq(a.state, b.state, "%llu", unsigned long long);
+    shi_test_end();
+}
+
+void advance_testsuite()
+{
+    fprintf(stderr, "test if advance(n) is same as generating n numbers\n");
+    const uint64_t deltas[] = {0, 1, 2, 3, 7, 8, 100, 1023, 65536, 1000003};
+    for(unsigned i = 0; i < ARRSIZE(deltas); ++i) {
+        advance_test(deltas[i]);
+    }
+    shi_test("advance(2^64 - 1) then advance(1)");
+    shlag_pcg32 a, b;
+    shlag_pcg32_srand(&a, 1, 2);
+    b = a;
+    shlag_pcg32_advance(&b, UINT64_MAX); // full period minus one
+    shlag_pcg32_advance(&b, 1);
+    shi_assert_eq(a.state, b.state, "%llu", unsigned long long);
+    shi_test_end();
+    fputs(SHI_SEP, stderr);
+}
+
+void split_testsuite()
+{
+    fprintf(stderr, "test if split() creates substreams that depend just on their index\n");
+    shlag_pcg32 rng, subs[8], subs2[3];
+    shlag_pcg32_srand(&rng, 42, 54);
+    const shlag_pcg32 orig = rng;
+    shlag_pcg32_split(&rng, subs, 0, ARRSIZE(subs));
+    shlag_pcg32_split(&rng, subs2, 5, ARRSIZE(subs2));
+    shi_test("split() leaves parent untouched");
+    shi_assert_eq(orig.state, rng.state, "%llu", unsigned long long);
+    shi_test_end();
+    for(unsigned i = 0; i < ARRSIZE(subs); ++i) {
+        shi_test("substream %u", i);
+        shlag_pcg32 expected = rng;
+        for(unsigned j = 0; j < i; ++j) shlag_pcg32_advance(&expected, SHLAG_PCG32_SUBSTREAM_LEN);
+        shi_assert_eq(expected.state, subs[i].state, "%llu", unsigned long long);
+        shi_assert_eq(rng.inc, subs[i].inc, "%llu", unsigned long long);
+        if(i >= 5) shi_assert_eq(subs[i].state, subs2[i-5].state, "%llu", unsigned long long);
+        shi_test_end();
+    }
+    fputs(SHI_SEP, stderr);
+}
+
+void x8_testsuite()
+{
+    fprintf(stderr, "test if pcg32x8 lanes match scalar generators\n");
+    uint64_t initstate[8], initseq[8];
+    shlag_pcg32 scalar[8];
+    for(unsigned i = 0; i < 8; ++i) {
+        initstate[i] = 2137 * i + 42;
+        initseq[i] = i == 7 ? UINT64_MAX : i; // last one checks that just low 63 bits matter
+        shlag_pcg32_srand(&scalar[i], initstate[i], initseq[i]);
+    }
+    shlag_pcg32x8 x8;
+    shlag_pcg32x8_srand(&x8, initstate, initseq);
+    shi_test("x8 srand() matches scalar srand()");
+    for(unsigned i = 0; i < 8; ++i) {
+        shi_assert_eq(scalar[i].state, shlag_pcg32x8_lane(&x8, i).state, "%llu", unsigned long long);
+        shi_assert_eq(scalar[i].inc, shlag_pcg32x8_lane(&x8, i).inc, "%llu", unsigned long long);
+    }
+    shi_test_end();
+    shi_test("x8 rand() matches scalar rand() for 1000 steps");
+    uint32_t out[8];
+    for(unsigned n = 0; n < 1000; ++n) {
+        shlag_pcg32x8_rand(&x8, out);
+        for(unsigned i = 0; i < 8; ++i) {
+            uint32_t expected = shlag_pcg32_rand(&scalar[i]);
+            shi_assert_f(expected == out[i], "step %u, lane %u: expected: %u, actual: %u", n, i, expected, out[i]);
+        }
+    }
+    shi_test_end();
+
+    shi_test("x8 made from split() substreams");
+    shlag_pcg32 subs[8];
+    shlag_pcg32_split(&scalar[0], subs, 0, 8);
+    shlag_pcg32x8_pack(&x8, subs);
+    shlag_pcg32x8_rand(&x8, out);
+    for(unsigned i = 0; i < 8; ++i) shi_assert_eq(shlag_pcg32_rand(&subs[i]), out[i], "%u", uint32_t);
+    shi_test_end();
+    fputs(SHI_SEP, stderr);
+}
+
+void pcg64_testsuite()
+{
+    fprintf(stderr, "test pcg64\n");
+    // from pcg64-demo (pcg-c), seeded with 42 54
+    const uint64_t expected[] = {0x86b1da1d72062b68, 0x1304aa46c9853d39, 0xa3670e9e0dd50358,
+        0xf9090e529a7dae00, 0xc85b9fd837996f2c, 0x606121f8e3919196};
+    shlag_pcg64 rng;
+    shlag_pcg64_srand(&rng, 42, 54);
+    shi_test("pcg64 rand() matches reference");
+    for(unsigned i = 0; i < ARRSIZE(expected); ++i) {
+        shi_assert_eq(expected[i], shlag_pcg64_rand(&rng), "0x%016llx", unsigned long long);
+    }
+    shi_test_end();
+
+    shi_test("pcg64 uses all 64 bits of initseq");
+    shlag_pcg64 a, b;
+    shlag_pcg64_srand(&a, 1, 1);
+    shlag_pcg64_srand(&b, 1, 1 | (1ULL << 63));
+    shi_assert_f(shlag_pcg64_rand(&a) != shlag_pcg64_rand(&b), "streams are the same");
+    shi_test_end();
+
+    const uint64_t ends[] = {0, 1, 2, 6, 1000, (1ULL << 32) + 1, (1ULL << 63) + 1, UINT64_MAX};
+    for(unsigned i = 0; i < ARRSIZE(ends); ++i) {
+        shi_test("pcg64 randrange0(%llu)", (unsigned long long)ends[i]);
+        uint64_t max = 0;
+        for(unsigned j = 0; j < 10000; ++j) {
+            uint64_t r = shlag_pcg64_randrange0(&rng, ends[i]);
+            shi_assert_f(r < ends[i] || (ends[i] == 0 && r == 0), "%llu out of range", (unsigned long long)r);
+            max = r > max ? r : max;
+        }
+        // range is well covered, even for huge bounds (so 64bit math is used all the way)
+        shi_assert_f(ends[i] < 2 || max >= ends[i] / 2, "max is just %llu", (unsigned long long)max);
+        shi_test_end();
+    }
+    shi_test("pcg64 randrange(5, 5) and randrange(UINT64_MAX-1, UINT64_MAX)");
+    shi_assert_eq(5, shlag_pcg64_randrange(&rng, 5, 5), "%llu", unsigned long long);
+    shi_assert_eq(UINT64_MAX - 1, shlag_pcg64_randrange(&rng, UINT64_MAX - 1, UINT64_MAX), "%llu", unsigned long long);
+    shi_test_end();
+
+    const uint64_t deltas[] = {0, 1, 2, 5, 1000, 65537};
+    for(unsigned i = 0; i < ARRSIZE(deltas); ++i) {
+        shi_test("pcg64 advance(%llu)", (unsigned long long)deltas[i]);
+        shlag_pcg64_srand(&a, 2137, deltas[i]);
+        b = a;
+        for(uint64_t j = 0; j < deltas[i]; ++j) shlag_pcg64_rand(&a);
+        shlag_pcg64_advance(&b, 0, deltas[i]);
+        shi_assert_eq(a.state[0], b.state[0], "%llu", unsigned long long);
+        shi_assert_eq(a.state[1], b.state[1], "%llu", unsigned long long);
+        // -delta as 128bit number goes back
+        shlag_pcg64_advance(&b, deltas[i] ? UINT64_MAX : 0, -deltas[i]);
+        shlag_pcg64_srand(&a, 2137, deltas[i]);
+        shi_assert_eq(a.state[0], b.state[0], "%llu", unsigned long long);
+        shi_assert_eq(a.state[1], b.state[1], "%llu", unsigned long long);
+        shi_test_end();
+    }
+    shi_test("pcg64 advance(2^64) is advance(2^63) twice, split() uses it");
+    shlag_pcg64 subs[3];
+    shlag_pcg64_split(&rng, subs, 1, 3);
+    a = rng;
+    shlag_pcg64_advance(&a, 0, 1ULL << 63);
+    shlag_pcg64_advance(&a, 0, 1ULL << 63);
+    shi_assert_eq(a.state[0], subs[0].state[0], "%llu", unsigned long long);
+    shi_assert_eq(a.state[1], subs[0].state[1], "%llu", unsigned long long);
+    shlag_pcg64_advance(&a, 2, 0);
+    shi_assert_eq(a.state[0], subs[2].state[0], "%llu", unsigned long long);
+    shi_assert_eq(a.state[1], subs[2].state[1], "%llu", unsigned long long);
+    shi_test_end();
+    fputs(SHI_SEP, stderr);
+}
+
+int main()
+{
+#ifdef __AVX2__
+    if(!__builtin_cpu_supports("avx2")) return 77; // tell meson to skip test
+#endif
+    rand_known_answer_test();
+    fill_testsuite();
+    bounded_testsuite();
+    float_testsuite();
+    normal_testsuite();
+    sample_testsuite();
+    reservoir_testsuite();
+    advance_testsuite();
+    split_testsuite();
+    x8_testsuite();
+    pcg64_testsuite();
+    return (shi_test_summary() > 0);
+}
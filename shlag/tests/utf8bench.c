@@ -0,0 +1,86 @@
+// Throughput benchmark for shlag_utf8. Output mimics google benchmark's console output, so
+// you can pipe it into `scripts/gmintbl`. Each benchmark processes SIZE bytes, so e.g.
+// 1MiB in 250us is 4GB/s. Compare scalar and SIMD builds like that:
+// ./utf8bench | gmintbl scalar > out
+// ./utf8bench_avx2 | gmintbl avx2 | join out - | column -t
+//
+// To build it without buildsystem, run something like:
+// cc -O2 -mavx2 -I. tests/utf8bench.c -o bin/utf8bench
+#define SHLAG_UTF8_IMPL
+#include "shlag_utf8.h"
+#define SHLAG_PCG_IMPL
+#include "shlag_pcg.h"
+#define SHITEST_IMPL
+#include "shitest.h"
+#include <stdlib.h>
+
+#define SIZE (1 << 20)
+
+typedef struct Ctx {
+    char* text;
+    int64_t len;
+    uint32_t* cps;
+} Ctx;
+
+static void validate(void* ctx)
+{
+    Ctx* c = (Ctx*)ctx;
+    shi_do_not_optimize(shlag_utf8_validate(c->text, c->len));
+}
+
+static void decode(void* ctx)
+{
+    Ctx* c = (Ctx*)ctx;
+    shi_do_not_optimize(shlag_utf8_decode(c->text, c->len, c->cps));
+}
+
+// fill @text with random codepoints below @maxCp (all sequences up to that length),
+// return length
+static int64_t fill(char* text, uint32_t maxCp, shlag_pcg32* rng)
+{
+    int64_t len = 0;
+    while(len < SIZE - 4) {
+        uint32_t cp = shlag_pcg32_randrange(rng, 0x20, maxCp);
+        if(cp >= 0xD800 && cp <= 0xDFFF) continue;
+        uint8_t* o = (uint8_t*)text + len;
+        if(cp < 0x80) { o[0] = cp; len += 1; }
+        else if(cp < 0x800) { o[0] = 0xC0 | cp >> 6; o[1] = 0x80 | (cp & 0x3F); len += 2; }
+        else if(cp < 0x10000) {
+            o[0] = 0xE0 | cp >> 12; o[1] = 0x80 | (cp >> 6 & 0x3F); o[2] = 0x80 | (cp & 0x3F);
+            len += 3;
+        } else {
+            o[0] = 0xF0 | cp >> 18; o[1] = 0x80 | (cp >> 12 & 0x3F);
+            o[2] = 0x80 | (cp >> 6 & 0x3F); o[3] = 0x80 | (cp & 0x3F);
+            len += 4;
+        }
+    }
+    return len;
+}
+
+int main()
+{
+    Ctx c;
+    c.text = (char*)malloc(SIZE);
+    c.cps = (uint32_t*)malloc(SIZE * sizeof(uint32_t));
+    if(!c.text || !c.cps) {
+        fprintf(stderr, "not enough memory\n");
+        return 1;
+    }
+    shlag_pcg32 rng;
+    shlag_pcg32_srand(&rng, 2137, 42);
+    // ascii: english-like text, latin: mostly 2 byte (polish-like), mixed: up to 4 bytes
+    const struct { const char* name; uint32_t maxCp; } texts[] = {
+        {"ascii", 0x80}, {"latin", 0x800}, {"mixed", 0x110000},
+    };
+    for(unsigned i = 0; i < sizeof(texts)/sizeof(texts[0]); ++i) {
+        char name[64];
+        c.len = fill(c.text, texts[i].maxCp, &rng);
+        snprintf(name, sizeof(name), "utf8_validate_%s/%d", texts[i].name, SIZE);
+        shi_bench(name, validate, &c);
+        snprintf(name, sizeof(name), "utf8_decode_%s/%d", texts[i].name, SIZE);
+        shi_bench(name, decode, &c);
+    }
+    free(c.text);
+    free(c.cps);
+    return 0;
+}
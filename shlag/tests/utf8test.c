@@ -0,0 +1,246 @@
+// Compile it with something like:
+// cc -I. tests/utf8test.c -o bin/utf8test
+// (add -mssse3 or -mavx2 to test vector kernels)
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#define SHLAG_UTF8_IMPL
+#include "shlag_utf8.h"
+#define SHLAG_PCG_IMPL
+#include "shlag_pcg.h"
+#define SHITEST_IMPL
+#include "shitest.h"
+
+#define ARRSIZE(arr) (sizeof(arr)/sizeof(arr[0]))
+
+// Reference validator, written as straightforwardly as possible: decode sequence
+// and check that codepoint is allowed and not encoded with too many bytes
+int64_t ref_validate(const uint8_t* in, int64_t len)
+{
+    int64_t i = 0;
+    while(i < len) {
+        int n;
+        uint32_t cp;
+        if(in[i] < 0x80) { ++i; continue; }
+        else if((in[i] & 0xE0) == 0xC0) { n = 2; cp = in[i] & 0x1F; }
+        else if((in[i] & 0xF0) == 0xE0) { n = 3; cp = in[i] & 0x0F; }
+        else if((in[i] & 0xF8) == 0xF0) { n = 4; cp = in[i] & 0x07; }
+        else return i;
+        if(i + n > len) return i;
+        for(int k = 1; k < n; ++k) {
+            if((in[i+k] & 0xC0) != 0x80) return i;
+            cp = cp << 6 | (in[i+k] & 0x3F);
+        }
+        const uint32_t minCp[] = {0, 0, 0x80, 0x800, 0x10000};
+        if(cp < minCp[n] || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF)) return i;
+        i += n;
+    }
+    return len;
+}
+
+// encode codepoint, return length
+int encode(uint32_t cp, uint8_t* out)
+{
+    if(cp < 0x80) { out[0] = cp; return 1; }
+    if(cp < 0x800) { out[0] = 0xC0 | cp >> 6; out[1] = 0x80 | (cp & 0x3F); return 2; }
+    if(cp < 0x10000) {
+        out[0] = 0xE0 | cp >> 12; out[1] = 0x80 | (cp >> 6 & 0x3F); out[2] = 0x80 | (cp & 0x3F);
+        return 3;
+    }
+    out[0] = 0xF0 | cp >> 18; out[1] = 0x80 | (cp >> 12 & 0x3F);
+    out[2] = 0x80 | (cp >> 6 & 0x3F); out[3] = 0x80 | (cp & 0x3F);
+    return 4;
+}
+
+// random valid codepoint, biased towards non-ASCII
+uint32_t random_cp(shlag_pcg32* rng)
+{
+    switch(shlag_pcg32_randrange0(rng, 5)) {
+    case 0: return shlag_pcg32_randrange0(rng, 0x80);
+    case 1: return shlag_pcg32_randrange(rng, 0x80, 0x800);
+    case 2: return shlag_pcg32_randrange(rng, 0x800, 0xD800);
+    case 3: return shlag_pcg32_randrange(rng, 0xE000, 0x10000);
+    default: return shlag_pcg32_randrange(rng, 0x10000, 0x110000);
+    }
+}
+
+typedef struct Sample {
+    const char* str;
+    int64_t validPrefix;
+    const char* desc;
+} Sample;
+
+// check @s placed at various offsets (so it crosses vector block boundaries), followed
+// by ASCII, and compare against expected and reference
+void known_sample_test(Sample s)
+{
+    shi_test("validate(%s)", s.desc);
+    uint8_t buf[128];
+    const int64_t n = strlen(s.str);
+    for(int64_t off = 0; off <= 64; ++off) {
+        memset(buf, 'a', sizeof(buf));
+        memcpy(buf + off, s.str, n);
+        for(int64_t len = off + n; len <= off + n + 33; len += 11) {
+            const int64_t expected = s.validPrefix == n ? len : off + s.validPrefix;
+            int64_t actual = shlag_utf8_validate((const char*)buf, len);
+            shi_assert_f(actual == expected, "offset %lld, len %lld: expected: %lld, actual: %lld",
+                    off, len, expected, actual);
+            shi_assert_eq(ref_validate(buf, len), actual, "%lld", int64_t);
+            if(shi_curTestStatus == SHI_FAIL) break;
+        }
+        if(shi_curTestStatus == SHI_FAIL) break;
+    }
+    shi_test_end();
+}
+
+void known_samples_testsuite()
+{
+    fprintf(stderr, "test validate() with known valid and invalid sequences\n");
+    Sample samples[] = {
+        {"", 0, "empty"},
+        {"zażółć gęślą jaźń", 26, "polish"},
+        {"\xe2\x82\xac", 3, "U+20AC"},
+        {"\xf0\x9f\x98\x80", 4, "U+1F600"},
+        {"\xc2\x80\xdf\xbf", 4, "U+0080 U+07FF"},
+        {"\xe0\xa0\x80\xef\xbf\xbf", 6, "U+0800 U+FFFF"},
+        {"\xed\x9f\xbf\xee\x80\x80", 6, "U+D7FF U+E000"},
+        {"\xf0\x90\x80\x80\xf4\x8f\xbf\xbf", 8, "U+10000 U+10FFFF"},
+        {"\x80", 0, "stray continuation"},
+        {"a\xbf", 1, "stray continuation after ASCII"},
+        {"\xe2\x82\xac\x80", 3, "continuation after complete sequence"},
+        {"\xc0\x80", 0, "overlong U+0000"},
+        {"\xc1\xbf", 0, "overlong U+007F"},
+        {"\xe0\x80\x80", 0, "overlong 3 byte"},
+        {"\xe0\x9f\xbf", 0, "overlong U+07FF"},
+        {"\xf0\x80\x80\x80", 0, "overlong 4 byte"},
+        {"\xf0\x8f\xbf\xbf", 0, "overlong U+FFFF"},
+        {"\xed\xa0\x80", 0, "surrogate U+D800"},
+        {"\xed\xbf\xbf", 0, "surrogate U+DFFF"},
+        {"\xf4\x90\x80\x80", 0, "U+110000"},
+        {"\xf5\x80\x80\x80", 0, "lead 0xF5"},
+        {"\xf8\x88\x80\x80\x80", 0, "5 byte sequence"},
+        {"\xff", 0, "0xFF"},
+        {"ab\xc3", 2, "truncated 2 byte"},
+        {"\xe2\x82", 0, "truncated 3 byte"},
+        {"\xf0\x9f\x98", 0, "truncated 4 byte"},
+        {"\xc3 ", 0, "2 byte lead followed by ASCII"},
+        {"\xe2\x82 ", 0, "3 byte sequence cut by ASCII"},
+        {"\xf0\x9f\x98\xc3\xb3", 0, "4 byte sequence cut by lead"},
+    };
+    for(unsigned i = 0; i < ARRSIZE(samples); ++i) known_sample_test(samples[i]);
+    fputs(SHI_SEP, stderr);
+}
+
+// all 1-2 byte combinations, and all 3-4 byte ones with interesting trailing bytes,
+// placed around block boundaries
+void exhaustive_testsuite()
+{
+    fprintf(stderr, "test validate() with all short sequences against reference\n");
+    const uint8_t tails[] = {0x00, 0x7F, 0x80, 0x8F, 0x90, 0x9F, 0xA0, 0xBF, 0xC0, 0xFF};
+    const int offsets[] = {0, 13, 14, 15, 16, 29, 30, 31, 32, 60};
+    uint8_t buf[80];
+    for(unsigned o = 0; o < ARRSIZE(offsets); ++o) {
+        const int off = offsets[o];
+        shi_test("byte pairs at offset %d", off);
+        memset(buf, 'a', sizeof(buf));
+        for(unsigned x = 0; x < 0x10000; ++x) {
+            buf[off] = x >> 8; buf[off+1] = x & 0xFF;
+            for(int64_t len = off + 2; len <= off + 3; ++len) {
+                int64_t expected = ref_validate(buf, len), actual = shlag_utf8_validate((char*)buf, len);
+                shi_assert_f(expected == actual, "%02x %02x, len %lld: expected: %lld, actual: %lld",
+                        buf[off], buf[off+1], len, expected, actual);
+            }
+            if(shi_curTestStatus == SHI_FAIL) break;
+        }
+        shi_test_end();
+        shi_test("3-4 byte sequences at offset %d", off);
+        for(unsigned lead = 0xE0; lead <= 0xFF; ++lead) {
+            for(unsigned b2 = 0x80; b2 <= 0xBF; ++b2) {
+                for(unsigned t3 = 0; t3 < ARRSIZE(tails); ++t3) {
+                    for(unsigned t4 = 0; t4 < ARRSIZE(tails); ++t4) {
+                        memset(buf, 'a', sizeof(buf));
+                        buf[off] = lead; buf[off+1] = b2; buf[off+2] = tails[t3]; buf[off+3] = tails[t4];
+                        const int64_t len = off + 4 + (t4 % 3); // sometimes ends right after it
+                        int64_t expected = ref_validate(buf, len), actual = shlag_utf8_validate((char*)buf, len);
+                        shi_assert_f(expected == actual, "%02x %02x %02x %02x: expected: %lld, actual: %lld",
+                                lead, b2, tails[t3], tails[t4], expected, actual);
+                    }
+                }
+            }
+        }
+        shi_test_end();
+    }
+    fputs(SHI_SEP, stderr);
+}
+
+// random valid text with few random bytes overwritten
+void fuzz_test()
+{
+    fprintf(stderr, "test validate() with mutated random text against reference\n");
+    shi_test("fuzz");
+    shlag_pcg32 rng;
+    shlag_pcg32_srand(&rng, 2137, 42);
+    uint8_t buf[1100];
+    for(int iter = 0; iter < 20000; ++iter) {
+        int64_t len = 0, maxLen = shlag_pcg32_randrange0(&rng, 1000);
+        while(len < maxLen) len += encode(random_cp(&rng), buf + len);
+        const int mutations = shlag_pcg32_randrange0(&rng, 4);
+        for(int k = 0; k < mutations && len > 0; ++k) {
+            buf[shlag_pcg32_randrange0(&rng, len)] = shlag_pcg32_rand(&rng);
+        }
+        int64_t expected = ref_validate(buf, len), actual = shlag_utf8_validate((char*)buf, len);
+        shi_assert_f(expected == actual, "iteration %d: expected: %lld, actual: %lld", iter, expected, actual);
+        if(expected != actual) break;
+    }
+    shi_test_end();
+    fputs(SHI_SEP, stderr);
+}
+
+void decode_testsuite()
+{
+    fprintf(stderr, "test decode()\n");
+    shi_test("decode(\"zażółć\")");
+    const uint32_t expected[] = {'z', 'a', 0x17C, 0xF3, 0x142, 0x107};
+    uint32_t out[16];
+    shi_assert_eq((int64_t)ARRSIZE(expected), shlag_utf8_decode("zażółć", strlen("zażółć"), out), "%lld", int64_t);
+    shi_assert_memeq(expected, out, sizeof(expected));
+    shi_test_end();
+
+    shi_test("decode() of invalid input");
+    shi_assert(shlag_utf8_decode("ab\xed\xa0\x80", 5, out) < 0);
+    shi_assert(shlag_utf8_decode("abc\xc3", 4, out) < 0);
+    shi_test_end();
+
+    shi_test("decode() roundtrip of random codepoints");
+    shlag_pcg32 rng;
+    shlag_pcg32_srand(&rng, 42, 2137);
+    uint32_t cps[600], decoded[2400];
+    uint8_t buf[2400];
+    for(int iter = 0; iter < 2000; ++iter) {
+        int64_t n = shlag_pcg32_randrange0(&rng, ARRSIZE(cps)), len = 0;
+        for(int64_t i = 0; i < n; ++i) {
+            // sometimes runs of ASCII, so fast path is used
+            cps[i] = iter % 2 ? random_cp(&rng) : shlag_pcg32_randrange0(&rng, 0x80);
+            len += encode(cps[i], buf + len);
+        }
+        int64_t count = shlag_utf8_decode((char*)buf, len, decoded);
+        shi_assert_f(count == n, "iteration %d: expected %lld codepoints, got %lld", iter, n, count);
+        if(count != n) break;
+        shi_assert_memeq_f(cps, decoded, n * sizeof(uint32_t), "iteration %d: decoded != encoded", iter);
+    }
+    shi_test_end();
+    fputs(SHI_SEP, stderr);
+}
+
+int main()
+{
+#ifdef __AVX2__
+    if(!__builtin_cpu_supports("avx2")) return 77; // tell meson to skip test
+#endif
+    known_samples_testsuite();
+    exhaustive_testsuite();
+    fuzz_test();
+    decode_testsuite();
+    return (shi_test_summary() > 0);
+}